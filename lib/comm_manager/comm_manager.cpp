@@ -10,66 +10,269 @@ extern QueueHandle_t gcodeQueue;
 extern QueueHandle_t sdQueue;
 
 CommManager commManager;
+static TaskHandle_t commTaskHandle = NULL;
+
+// Mots-clés des commandes de service ; toute autre ligne est du G-code (G/M, N..*,
+// O<n>, #<n>=, IF [...]) et passe par acceptLine puis gcodeQueue
+static const char *const kServiceCommands[] = {
+  "READ_SD", "READ_SD_LAYER", "READ_SD_LINE", "INDEX_SD", "SCAN_SD", "TEST_SD", "TEST_SYSTEM", "CLEAR_GCODE",
+  "LIST_SD", "REFRESH_SD", "RESUME", "SD_STATS", "ERROR_POLICY", "TEST_PARSE"
+};
+
+static bool isServiceCommand(const char *text) {
+  for (size_t n = 0; n < sizeof(kServiceCommands) / sizeof(kServiceCommands[0]); n++) {
+    size_t len = strlen(kServiceCommands[n]);
+    if (strncmp(text, kServiceCommands[n], len) == 0 && (text[len] == '\0' || text[len] == ' ')) return true;
+  }
+  return false;
+}
+
+// Entier décimal non signé occupant tout le texte
+static bool parseUnsigned(const String &text, uint32_t &value) {
+  char *end;
+  value = strtoul(text.c_str(), &end, 10);
+  return !text.isEmpty() && isDigit(text[0]) && *end == '\0';
+}
 
 void CommManager::commTask(void *pvParameters) {
+  commTaskHandle = xTaskGetCurrentTaskHandle();
+#if !ARDUINO_USB_CDC_ON_BOOT
+  // Réveil par l'UART à chaque réception plutôt que par scrutation périodique
+  Serial.onReceive([]() {
+    if (commTaskHandle) xTaskNotifyGive(commTaskHandle);
+  });
+#endif
   while (1) {
-    if (Serial.available()) {
-      String line = Serial.readStringUntil('\n');
-      line.trim();
-      if (line.isEmpty()) {
-        DEBUG_PRINTF_AUTO("Commande série vide ignorée");
+    if (!Serial.available()) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(COMM_IDLE_WAIT_MS)); // Repli si aucune notification
+      continue;
+    }
+    // Lecture directe dans un slab du pool : la ligne G-code part telle quelle vers parserTask
+    LineSlab *slab = linePool.acquire(pdMS_TO_TICKS(COMM_IDLE_WAIT_MS));
+    if (!slab) {
+      DEBUG_PRINTF_AUTO("Pool de lignes épuisé, lecture série différée");
+      continue;
+    }
+    slab->length = Serial.readBytesUntil('\n', slab->text, LINE_SLAB_BYTES - 1);
+    slab->text[slab->length] = '\0';
+    slab->trim();
+    if (slab->length == 0) {
+      linePool.recycle(slab);
+      DEBUG_PRINTF_AUTO("Commande série vide ignorée");
+      continue;
+    }
+    DEBUG_PRINTF_AUTO("Commande série reçue: %s", slab->text);
+    if (!isServiceCommand(slab->text)) {
+      commManager.handleGcodeLine(slab);
+      continue;
+    }
+    // Commandes de service : rares, traitées sur une copie
+    String line(slab->text);
+    linePool.recycle(slab);
+    if (line.startsWith("READ_SD ")) {
+      String filename = line.substring(8);
+      filename.trim();
+      if (filename.isEmpty()) {
+        DEBUG_PRINTF_AUTO("Erreur: Nom de fichier vide pour READ_SD");
+        Serial.println("ERROR: Empty filename");
         continue;
       }
-      DEBUG_PRINTF_AUTO("Commande série reçue: %s", line.c_str());
-      if (line.startsWith("READ_SD ")) {
-        String filename = line.substring(8);
-        filename.trim();
-        if (filename.isEmpty()) {
-          DEBUG_PRINTF_AUTO("Erreur: Nom de fichier vide pour READ_SD");
-          Serial.println("ERROR: Empty filename");
-          continue;
-        }
-        sdManager.readFile(filename);
-        Serial.println("OK: READ_SD command sent");
-      } else if (line.startsWith("TEST_SD ")) {
-        String filename = line.substring(8);
-        filename.trim();
-        if (filename.isEmpty()) {
-          DEBUG_PRINTF_AUTO("Erreur: Nom de fichier vide pour TEST_SD");
-          Serial.println("ERROR: Empty filename");
-          continue;
-        }
-        sdManager.testReadSD(filename);
-        Serial.println("OK: TEST_SD command sent");
-      } else if (line.startsWith("TEST_SYSTEM")) {
-        systemManager.testSystem();
-        Serial.println("OK: TEST_SYSTEM command sent");
-      } else if (line.startsWith("CLEAR_GCODE")) {
-        xQueueReset(gcodeQueue);
-        DEBUG_PRINTF_AUTO("gcodeQueue vidée via commande CLEAR_GCODE");
-        Serial.println("OK: gcodeQueue cleared");
-      } else if (line.startsWith("LIST_SD")) {
-        sdManager.listFiles();
-        DEBUG_PRINTF_AUTO("Commande LIST_SD exécutée");
-      } else if (line.startsWith("TEST_PARSE ")) {
-        String cmd = line.substring(11);
-        cmd.trim();
-        if (cmd.isEmpty()) {
-          DEBUG_PRINTF_AUTO("Erreur: Commande vide pour TEST_PARSE");
-          Serial.println("ERROR: Empty command");
-          continue;
+      sdManager.readFile(filename);
+      Serial.println("OK: READ_SD command sent");
+    } else if (line.startsWith("READ_SD_LAYER ") || line.startsWith("READ_SD_LINE ")) {
+      // READ_SD_LAYER <couche> <fichier> / READ_SD_LINE <ligne> <fichier> : départ indexé
+      bool by_layer = line.startsWith("READ_SD_LAYER ");
+      String args = line.substring(by_layer ? 14 : 13);
+      args.trim();
+      char *end;
+      long start = strtol(args.c_str(), &end, 10);
+      String filename = String(end);
+      filename.trim();
+      if (end == args.c_str() || filename.isEmpty()) {
+        DEBUG_PRINTF_AUTO("Erreur: Usage %s <n> <fichier>", by_layer ? "READ_SD_LAYER" : "READ_SD_LINE");
+        Serial.println("ERROR: Expected <number> <filename>");
+        continue;
+      }
+      sdManager.readFileFrom(filename, by_layer, start);
+      Serial.println("OK: READ_SD command sent");
+    } else if (line.startsWith("INDEX_SD ")) {
+      String filename = line.substring(9);
+      filename.trim();
+      if (filename.isEmpty()) {
+        DEBUG_PRINTF_AUTO("Erreur: Nom de fichier vide pour INDEX_SD");
+        Serial.println("ERROR: Empty filename");
+        continue;
+      }
+      sdManager.indexFile(filename);
+      Serial.println("OK: INDEX_SD command sent");
+    } else if (line.startsWith("SCAN_SD")) {
+      // SCAN_SD <fichier> : résumé d'un fichier ; SCAN_SD seul : fichiers de la racine sans résumé
+      String filename = line.substring(7);
+      filename.trim();
+      sdManager.scanFile(filename);
+      Serial.println("OK: SCAN_SD command sent");
+    } else if (line.startsWith("TEST_SD ")) {
+      String filename = line.substring(8);
+      filename.trim();
+      if (filename.isEmpty()) {
+        DEBUG_PRINTF_AUTO("Erreur: Nom de fichier vide pour TEST_SD");
+        Serial.println("ERROR: Empty filename");
+        continue;
+      }
+      sdManager.testReadSD(filename);
+      Serial.println("OK: TEST_SD command sent");
+    } else if (line.startsWith("TEST_SYSTEM")) {
+      systemManager.testSystem();
+      Serial.println("OK: TEST_SYSTEM command sent");
+    } else if (line.startsWith("CLEAR_GCODE")) {
+      clearGcodeQueue();
+      DEBUG_PRINTF_AUTO("gcodeQueue vidée via commande CLEAR_GCODE");
+      Serial.println("OK: gcodeQueue cleared");
+    } else if (line.startsWith("LIST_SD")) {
+      // LIST_SD [dossier] [<offset> <nombre>] : page de l'arborescence en cache, tout le dossier sans nombre
+      String path = line.substring(7);
+      path.trim();
+      uint32_t offset = 0, count = UINT32_MAX;
+      int split = path.lastIndexOf(' ');
+      if (split > 0) {
+        int first = path.lastIndexOf(' ', split - 1); // -1 : racine implicite
+        uint32_t page_offset, page_count;
+        if (parseUnsigned(path.substring(first + 1, split), page_offset) &&
+            parseUnsigned(path.substring(split + 1), page_count)) {
+          offset = page_offset;
+          count = page_count;
+          path = first < 0 ? String() : path.substring(0, first);
         }
-        gcodeParser.testParse(cmd);
-        Serial.println("OK: TEST_PARSE command sent");
-      } else {
-        DEBUG_PRINTF_AUTO("Commande non reconnue: %s", line.c_str());
-        Serial.println("ERROR: Unknown command");
       }
+      sdManager.listFiles(path, offset, count);
+      DEBUG_PRINTF_AUTO("Commande LIST_SD exécutée");
+    } else if (line.startsWith("REFRESH_SD")) {
+      sdManager.refreshFiles();
+      Serial.println("OK: REFRESH_SD command sent");
+    } else if (line.startsWith("RESUME")) {
+      sdManager.resume();
+      Serial.println("OK: RESUME command sent");
+    } else if (line.startsWith("SD_STATS")) {
+      sdManager.printReadStats();
+    } else if (line.startsWith("ERROR_POLICY ")) {
+      String policy = line.substring(13);
+      policy.trim();
+      policy.toLowerCase();
+      ParseErrorPolicy value;
+      if (policy == "abort") value = ParseErrorPolicy::ABORT;
+      else if (policy == "skip") value = ParseErrorPolicy::SKIP;
+      else if (policy == "count") value = ParseErrorPolicy::COUNT;
+      else {
+        DEBUG_PRINTF_AUTO("Erreur: Politique d'erreur inconnue '%s'", policy.c_str());
+        Serial.println("ERROR: Unknown error policy (abort, skip, count)");
+        continue;
+      }
+      gcodeParser.lock();
+      parseErrors.setPolicy(value);
+      gcodeParser.unlock();
+      DEBUG_PRINTF_AUTO("Politique d'erreur: %s", policy.c_str());
+      Serial.println("OK: Error policy set");
+    } else if (line.startsWith("TEST_PARSE ")) {
+      String cmd = line.substring(11);
+      cmd.trim();
+      if (cmd.isEmpty()) {
+        DEBUG_PRINTF_AUTO("Erreur: Commande vide pour TEST_PARSE");
+        Serial.println("ERROR: Empty command");
+        continue;
+      }
+      gcodeParser.testParse(cmd);
+      Serial.println("OK: TEST_PARSE command sent");
+    } else {
+      DEBUG_PRINTF_AUTO("Commande non reconnue: %s", line.c_str());
+      Serial.println("ERROR: Unknown command");
     }
-    vTaskDelay(pdMS_TO_TICKS(10));
   }
 }
 
+// Ligne G-code envoyée par un hôte (Pronterface, OctoPrint...) : vérifie N/checksum,
+// la suit en séquence et répond "ok" ou "Resend:" comme Marlin. Le slab est transmis à
+// parserTask ou rendu au pool.
+void CommManager::handleGcodeLine(LineSlab *slab) {
+  bool numbered;
+  long line_number;
+  if (!acceptLine(slab->text, slab->length, numbered, line_number)) {
+    linePool.recycle(slab);
+    return;
+  }
+  // Ligne série : line_number à 0, erreurs signalées immédiatement
+  if (!sendGcodeLine(slab, pdMS_TO_TICKS(5000))) {
+    linePool.recycle(slab);
+    DEBUG_PRINTF_AUTO("Erreur: Impossible d'envoyer à gcodeQueue après 5s");
+    // Numéro non retenu : l'hôte renvoie la ligne perdue plutôt que d'attendre son "ok"
+    if (numbered) requestResend("Failed to send to gcodeQueue");
+    else Serial.println("ERROR: Failed to send to gcodeQueue");
+    return;
+  }
+  if (numbered) last_line_number = line_number; // Retenu une fois la ligne en file
+  Serial.println("ok");
+}
+
+// Contrôle N/checksum/séquence ; false si la ligne ne doit pas être exécutée (renvoi
+// demandé ou M110 traité ici). Le numéro d'une ligne acceptée est rendu dans line_number,
+// à retenir par l'appelant une fois la ligne en file.
+bool CommManager::acceptLine(const char *text, size_t len, bool &numbered, long &line_number) {
+  NumberedLine parsed;
+  LineCheck check = checkNumberedLine(text, len, parsed);
+  if (check == LineCheck::MALFORMED) {
+    requestResend("Malformed line number or checksum");
+    return false;
+  }
+  // "N-1 M110*15" : sans paramètre N, M110 reprend le numéro de sa propre ligne
+  long reset_number = parsed.has_line_number ? parsed.line_number : last_line_number;
+  bool line_number_reset = isLineNumberReset(parsed.body, parsed.body_len, reset_number);
+  if (parsed.has_line_number) {
+    if (!parsed.has_checksum) {
+      requestResend("No Checksum with line number");
+      return false;
+    }
+    if (check == LineCheck::BAD_CHECKSUM) {
+      requestResend("checksum mismatch");
+      return false;
+    }
+    if (!line_number_reset && parsed.line_number != last_line_number + 1) {
+      requestResend("Line Number is not Last Line Number+1");
+      return false;
+    }
+  }
+
+  if (line_number_reset) {
+    last_line_number = reset_number;
+    DEBUG_PRINTF_AUTO("Numéro de ligne réinitialisé à %ld", last_line_number);
+    Serial.println("ok");
+    return false;
+  }
+  numbered = parsed.has_line_number;
+  line_number = parsed.line_number;
+  return true;
+}
+
+// M110 [N<ligne>] : redéfinit le numéro de la dernière ligne reçue ; line_number garde
+// la valeur passée par l'appelant en l'absence de N
+bool CommManager::isLineNumberReset(const char *body, size_t len, long &line_number) {
+  const char *p = body;
+  const char *end = body + len;
+  while (p < end && *p == ' ') p++;
+  if (end - p < 4 || (p[0] != 'M' && p[0] != 'm') || strncmp(p + 1, "110", 3) != 0) return false;
+  p += 4;
+  if (p < end && *p >= '0' && *p <= '9') return false; // M1100...
+  while (p < end && *p == ' ') p++;
+  if (p < end && (*p == 'N' || *p == 'n')) line_number = strtol(p + 1, NULL, 10);
+  return true;
+}
+
+void CommManager::requestResend(const char *reason) {
+  while (Serial.available()) Serial.read(); // L'hôte renverra tout à partir de la ligne demandée
+  DEBUG_PRINTF_AUTO("Erreur protocole: %s, demande de renvoi de la ligne %ld", reason, last_line_number + 1);
+  Serial.printf("Error:%s, Last Line: %ld\n", reason, last_line_number);
+  Serial.printf("Resend: %ld\n", last_line_number + 1);
+  Serial.println("ok");
+}
+
 void CommManager::init() {
   Serial.begin(115200);
 }
@@ -86,7 +289,7 @@ void CommManager::testComm(String cmd) {
     filename.trim();
     sdManager.testReadSD(filename);
   } else if (cmd.startsWith("CLEAR_GCODE")) {
-    xQueueReset(gcodeQueue);
+    clearGcodeQueue();
     DEBUG_PRINTF_AUTO("Test: gcodeQueue vidée");
   } else if (cmd.startsWith("LIST_SD")) {
     sdManager.listFiles();
@@ -1,11 +1,19 @@
 #pragma once
 
 #include <Arduino.h>
+#include "line_pool.h"
 
 class CommManager {
 private:
+    long last_line_number; // Dernier numéro de ligne N accepté (protocole hôte)
+    void requestResend(const char *reason);
+    bool isLineNumberReset(const char *body, size_t len, long &line_number);
+    bool acceptLine(const char *text, size_t len, bool &numbered, long &line_number);
+
 public:
+    CommManager() : last_line_number(0) {}
     void init();
+    void handleGcodeLine(LineSlab *slab);
     void testComm(String cmd);
     static void commTask(void *pvParameters);
 };
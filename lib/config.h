@@ -12,4 +12,102 @@
 #define LED_PIN    48     // Pin à laquelle est connectée ta LED RGB
 #define NUM_LEDS   1     // Nombre de LEDs
 #define COLOR_ORDER GRB  // Ordre des couleurs selon ta LED
-#define STABILITY_DELAY 3000
\ No newline at end of file
+#define STABILITY_DELAY 3000
+//Pipeline de mouvement
+// 1 : motionQueue transporte des MotionCommandFixed (µm, mm/min x1000), 0 : des MotionCommand (float)
+#ifndef MOTION_FIXED_POINT
+#define MOTION_FIXED_POINT 0
+#endif
+// Budget mémoire de motionQueue en octets (~24 octets par G1 XYE une fois compacté)
+#define MOTION_QUEUE_BYTES (12 * 1024)
+#define SPSC_CACHE_LINE 32             // Ligne de cache ESP32-S3 : sépare les indices des files SPSC
+// Contrôle de flux : le producteur s'arrête au-dessus du seuil haut et repart sous le seuil bas
+#define MOTION_QUEUE_HIGH_WATERMARK (MOTION_QUEUE_BYTES * 3 / 4)
+#define MOTION_QUEUE_LOW_WATERMARK (MOTION_QUEUE_BYTES / 4)
+#define GCODE_QUEUE_LENGTH 10          // Lignes en attente de parserTask
+#define GCODE_QUEUE_HIGH_WATERMARK 8
+#define GCODE_QUEUE_LOW_WATERMARK 2
+#define COMM_IDLE_WAIT_MS 100          // commTask : attente maximale sans notification de réception
+// Lignes en transit entre commTask, sdTask et parserTask : gcodeQueue et sdQueue pleines,
+// plus une ligne en cours de remplissage par producteur et une en cours de parsing
+#define SD_QUEUE_LENGTH 5
+#define LINE_SLAB_COUNT (GCODE_QUEUE_LENGTH + SD_QUEUE_LENGTH + 3)
+#define LINE_SLAB_BYTES 512
+
+// Arcs G2/G3 : découpage en segments G1
+#define ARC_CHORD_TOLERANCE_MM 0.1f      // Écart maximal corde / arc
+#define ARC_MIN_SEGMENT_MM 0.5f
+#define ARC_MAX_SEGMENT_MM 20.0f
+#define ARC_MAX_SEGMENTS_PER_SECOND 50.0f // Au-delà, les segments s'allongent avec la vitesse
+// Sous-programmes O<n> ... M99, appelés par M98 P<n> L<répétitions> Z<décalage par répétition>
+#define SUBROUTINE_MAX 16                    // Sous-programmes définis simultanément
+#define SUBROUTINE_MAX_DEPTH 4               // Imbrication des appels M98
+#define SUBROUTINE_CACHE_BYTES (1024 * 1024) // Corps pré-découpés, en PSRAM
+
+// Fusion des G0/G1 quasi colinéaires avant motionQueue (0 : désactivée)
+#ifndef MOTION_MERGE_SEGMENTS
+#define MOTION_MERGE_SEGMENTS 1
+#endif
+#define MOTION_MERGE_MAX_SEGMENTS 16            // Segments réunis au plus en un mouvement
+#define MOTION_MERGE_MAX_ANGLE_DEG 2.0f         // Changement de direction maximal à chaque jonction
+#define MOTION_MERGE_MAX_DEVIATION_MM 0.01f     // Écart maximal d'une jonction absorbée à la corde
+#define MOTION_MERGE_EXTRUSION_TOLERANCE 0.05f  // Écart relatif maximal du ratio E / longueur XY
+#define MOTION_MIN_SEGMENT_MM (1.0f / 80.0f)    // Un pas à 80 pas/mm : absorbé sans contrôle d'angle
+#define MOTION_MERGE_IDLE_MS 50                 // parserTask libère le mouvement en attente après ce délai
+
+// Index SD (fichier voisin <nom>.idx) : départ à une couche ou à une ligne sans relire le début
+#define GCODE_INDEX_EXTENSION ".idx"
+#define GCODE_INDEX_LAYER_EXTENSION ".idl"    // Table des couches pendant la construction
+#define GCODE_INDEX_LINE_STRIDE 1000          // Une entrée toutes les N lignes
+#define GCODE_INDEX_STEP_BYTES (32u * 1024u)  // sdTask indexe par pas entre deux fichiers
+#define GCODE_INDEX_READ_BYTES 4096
+#define GCODE_INDEX_QUEUE_LENGTH 4             // INDEX_SD et SCAN_SD en attente derrière la passe en cours
+#define GCODE_INDEX_LAYER_MIN_DZ 0.01f        // Sans ;LAYER, une couche commence à chaque nouveau Z maximal
+// Résumé d'un G-code (fichier voisin <nom>.meta), calculé par la même passe que l'index
+#define GCODE_META_EXTENSION ".meta"
+#define GCODE_META_E_AREA_MM2 2.405f          // mm³ par mm de E : filament 1,75 mm (1.0 si E est déjà un volume)
+
+// Points de reprise après coupure (mode fusionné) : secteurs réservés de CHECKPOINT_FILE,
+// écrits à tour de rôle pour répartir l'usure de la carte
+#define CHECKPOINT_FILE "/checkpoint.bin"
+#define CHECKPOINT_SLOTS 64                   // Secteurs de 512 octets
+#define CHECKPOINT_INTERVAL_MS 5000           // Écart minimal entre deux captures
+#define CHECKPOINT_INTERVAL_MAX_MS 60000      // Plafond quand l'intervalle est allongé
+#define CHECKPOINT_MAX_OVERHEAD_PERMILLE 10   // Au-delà de 1 % du temps de lecture, l'intervalle double
+#define CHECKPOINT_PENDING 4                  // Captures en attente d'exécution par le consommateur de motionQueue
+#define CHECKPOINT_NAME_BYTES 256
+#define CHECKPOINT_RESUME_LIFT_MM 5.0f        // Dégagement en Z avant le retour en XY
+#define CHECKPOINT_RESUME_FEEDRATE 3000       // mm/min pour les déplacements de reprise
+
+// Cache de l'arborescence SD (PSRAM, deux exemplaires) : LIST_SD et l'interface lisent
+// l'exemplaire publié pendant que sdTask reconstruit l'autre entre deux fichiers
+#define SD_DIRECTORY_MAX_ENTRIES 4096         // Fichiers et dossiers, résumés .meta compris
+#define SD_DIRECTORY_NAME_POOL_BYTES (128u * 1024u)
+#define SD_DIRECTORY_MAX_METADATA 1024        // Résumés G-code gardés en cache
+#define SD_DIRECTORY_MAX_DEPTH 8              // Dossiers plus profonds ignorés
+#define SD_DIRECTORY_PATH_BYTES 256
+#define SD_DIRECTORY_STEP_ENTRIES 32          // Entrées lues par pas de sdTask
+#define SD_DIRECTORY_LIST_BATCH 8             // Entrées copiées par prise du verrou pour LIST_SD
+
+// Lecture SD : 1 découpe les lignes directement dans le tampon de lecture (sdTask),
+// 0 les transmet à parserTask par gcodeQueue
+#ifndef SD_FUSED_PARSE
+#define SD_FUSED_PARSE 1
+#endif
+#define SD_READ_BUFFER_BYTES 1024 // Longueur maximale d'une ligne en mode fusionné
+// Lecture anticipée (mode fusionné) : blocs lus par ReadAheadTask sur le cœur 0
+#define SD_SECTOR_BYTES 512                     // Secteur de la carte, unité des lectures directes
+#define SD_READ_AHEAD_BLOCK_BYTES (32u * 1024u) // Multiple de SD_SECTOR_BYTES : lectures multi-secteurs directes
+#define SD_READ_AHEAD_BUFFERS 2                 // Un bloc découpé pendant que l'autre se remplit
+#define SD_READ_AHEAD_PSRAM 1                   // Repli en PSRAM si la mémoire DMA interne manque
+// Mode fusionné : 1 découpe et tokenise sur le cœur 0 (PreparseTask) en avance sur la
+// passe séquentielle de sdTask (cœur 1)
+#ifndef SD_PARALLEL_PARSE
+#define SD_PARALLEL_PARSE 1
+#endif
+#define PREPARSE_CHUNK_LINES 32 // Lignes non vides par bloc
+#define PREPARSE_SLOTS 4        // Blocs d'avance au plus, en PSRAM (~8 Ko chacun)
+
+// Erreurs de parsing d'un fichier : enregistrées dans un anneau, résumées en fin de fichier
+#define PARSE_ERROR_RING_SIZE 16
+#define PARSE_ERROR_POLICY 1 // 0 : abandon à la première erreur, 1 : ligne ignorée et enregistrée, 2 : comptée seulement
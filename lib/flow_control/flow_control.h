@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Contrôle de flux par seuils entre un producteur et le consommateur d'une file.
+// Le producteur ne s'arrête que si la file dépasse le seuil haut, puis dort jusqu'à
+// ce que le consommateur la ramène sous le seuil bas et le réveille : le rythme suit la
+// consommation réelle au lieu de délais fixes. Le réveil passe par un sémaphore binaire
+// propre à la file, pas par la notification de tâche que le producteur attend déjà pour
+// autre chose (réception UART, blocs prêts). Un seul producteur est réveillé ; un second
+// en attente au même moment revérifie la file à chaque stall_ticks.
+class FlowControl {
+private:
+  size_t high, low;
+  SemaphoreHandle_t wakeup;          // Donné par le consommateur au producteur endormi
+  std::atomic<bool> waiting;         // Producteur endormi sur wakeup
+
+  void wake() {
+    if (waiting.exchange(false)) xSemaphoreGive(wakeup);
+  }
+
+public:
+  FlowControl() : high(0), low(0), wakeup(NULL), waiting(false) {}
+  bool init(size_t high_level, size_t low_level) {
+    high = high_level;
+    low = low_level;
+    if (!wakeup) wakeup = xSemaphoreCreateBinary();
+    return wakeup != NULL;
+  }
+
+  // Producteur, avant d'ajouter : level() donne le remplissage courant. stall_ticks borne
+  // l'attente sans progrès du consommateur, pas l'attente totale. Retourne false si la
+  // file est restée bloquée.
+  template <typename Level>
+  bool admit(Level level, TickType_t stall_ticks) {
+    size_t current = level();
+    if (current <= high) return true;
+    if (!wakeup) return false; // init() non appelé
+    while (1) {
+      // Attente publiée avant le contrôle : le consommateur la voit ou nous voyons son retrait.
+      // Un jeton resté d'un réveil précédent provoque seulement un nouveau contrôle.
+      waiting = true;
+      if ((current = level()) <= low) break;
+      if (xSemaphoreTake(wakeup, stall_ticks) != pdTRUE && level() >= current) {
+        waiting = false;
+        return false;
+      }
+    }
+    waiting = false;
+    return true;
+  }
+
+  // Consommateur, après un retrait : réveille le producteur sous le seuil bas
+  void drained(size_t level) {
+    if (level <= low) wake();
+  }
+
+  // File vidée (arrêt d'urgence) : le producteur reprend immédiatement
+  void release() { wake(); }
+};
@@ -0,0 +1,226 @@
+#include "gcode_binary.h"
+#include <string.h>
+
+// Lettres codées dans l'ordre des bits du masque, et nombre de décimales conservées
+static const char kLetters[GCODE_BINARY_LETTERS] = {'X', 'Y', 'Z', 'E', 'F', 'S', 'I', 'J', 'R', 'P', 'L'};
+static const uint8_t kScales[GCODE_BINARY_LETTERS] = {3, 3, 3, 5, 3, 3, 3, 3, 3, 0, 0};
+static const char kTypes[] = {'G', 'M', 'O', '#'};
+
+static const uint8_t kHasCondition = 1;
+static const uint8_t kHasValue = 2;
+
+static const int64_t kPow10[] = {
+  1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+  100000000LL, 1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL
+};
+
+void GcodeBinaryState::reset() {
+  memset(last, 0, sizeof(last));
+}
+
+static int letterIndex(char letter) {
+  for (int i = 0; i < GCODE_BINARY_LETTERS; i++) {
+    if (kLetters[i] == letter) return i;
+  }
+  return -1;
+}
+
+static size_t putVarint(uint8_t *out, uint64_t value) {
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = static_cast<uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = static_cast<uint8_t>(value);
+  return n;
+}
+
+// Retourne les octets lus, 0 si incomplet, -1 si trop long
+static int getVarint(const uint8_t *data, size_t len, uint64_t &value) {
+  value = 0;
+  for (size_t n = 0; n < 10; n++) {
+    if (n == len) return 0;
+    value |= static_cast<uint64_t>(data[n] & 0x7F) << (7 * n);
+    if (!(data[n] & 0x80)) return static_cast<int>(n + 1);
+  }
+  return -1;
+}
+
+static inline uint64_t zigzag(int64_t v) {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v) {
+  return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+// Décimal exact -> entier à 'scale' décimales (arrondi si le texte en a davantage)
+static int64_t toScaled(const GcodeDecimal &value, uint8_t scale) {
+  if (value.decimals <= scale) return static_cast<int64_t>(value.mantissa) * kPow10[scale - value.decimals];
+  int64_t divisor = kPow10[value.decimals - scale];
+  int64_t half = divisor / 2;
+  return value.mantissa >= 0 ? (value.mantissa + half) / divisor : (value.mantissa - half) / divisor;
+}
+
+// Entier mis à l'échelle -> décimal ; même valeur exacte que le texte d'origine,
+// donc même float après gcodeDecimalToFloat
+static GcodeDecimal fromScaled(int64_t value, uint8_t scale) {
+  while (scale > 0 && value % 10 == 0) {
+    value /= 10;
+    scale--;
+  }
+  while (scale > 0 && (value > INT32_MAX || value < INT32_MIN)) {
+    value = (value + (value >= 0 ? 5 : -5)) / 10;
+    scale--;
+  }
+  GcodeDecimal out;
+  out.mantissa = static_cast<int32_t>(value > INT32_MAX ? INT32_MAX : (value < INT32_MIN ? INT32_MIN : value));
+  out.decimals = scale;
+  return out;
+}
+
+void writeGcodeBinaryHeader(uint8_t *out, uint32_t command_count) {
+  memset(out, 0, GCODE_BINARY_HEADER_SIZE);
+  memcpy(out, GCODE_BINARY_MAGIC, 4);
+  out[4] = GCODE_BINARY_VERSION & 0xFF;
+  out[5] = GCODE_BINARY_VERSION >> 8;
+  out[6] = GCODE_BINARY_HEADER_SIZE;
+  for (int i = 0; i < 4; i++) out[8 + i] = static_cast<uint8_t>(command_count >> (8 * i));
+}
+
+bool readGcodeBinaryHeader(const uint8_t *data, size_t len, uint32_t &command_count) {
+  if (len < GCODE_BINARY_HEADER_SIZE || memcmp(data, GCODE_BINARY_MAGIC, 4) != 0) return false;
+  uint16_t version = data[4] | (data[5] << 8);
+  uint16_t header_size = data[6] | (data[7] << 8);
+  if (version != GCODE_BINARY_VERSION || header_size != GCODE_BINARY_HEADER_SIZE) return false;
+  command_count = 0;
+  for (int i = 0; i < 4; i++) command_count |= static_cast<uint32_t>(data[8 + i]) << (8 * i);
+  return true;
+}
+
+// Copie l'expression située à offset dans le bytecode de la ligne
+static size_t appendExpression(const TokenizedLine &line, uint8_t offset, uint8_t *out) {
+  if (offset >= line.code_size) return 0;
+  size_t len = gcodeExpressionLength(line.bytecode + offset, line.code_size - offset);
+  memcpy(out, line.bytecode + offset, len);
+  return len;
+}
+
+size_t encodeGcodeRecord(const TokenizedLine &line, GcodeBinaryState &state, uint8_t *out) {
+  // Une lettre répétée garde sa dernière valeur, comme wordsToCommand
+  int64_t values[GCODE_BINARY_LETTERS];
+  uint8_t expressions[GCODE_BINARY_LETTERS];
+  uint32_t mask = 0, expression_mask = 0;
+  for (uint8_t n = 0; n < line.count; n++) {
+    const GcodeWord &word = line.words[n];
+    int index = letterIndex(word.letter);
+    if (index < 0) return 0;
+    mask |= 1UL << index;
+    if (word.expression != GCODE_NO_EXPRESSION) {
+      expressions[index] = word.expression;
+      expression_mask |= 1UL << index;
+    } else {
+      values[index] = toScaled(word.value, kScales[index]);
+      expression_mask &= ~(1UL << index);
+    }
+  }
+  uint8_t flags = (line.condition != GCODE_NO_EXPRESSION ? kHasCondition : 0) |
+                  (line.type == '#' ? kHasValue : 0);
+  if (expression_mask || flags) mask |= GCODE_BINARY_HAS_EXPRESSIONS;
+
+  uint64_t kind = line.type == 'M' ? 1 : (line.type == 'O' ? 2 : (line.type == '#' ? 3 : 0));
+  size_t size = putVarint(out, (static_cast<uint64_t>(line.code) << 2) | kind);
+  size += putVarint(out + size, mask);
+  if (mask & GCODE_BINARY_HAS_EXPRESSIONS) {
+    uint8_t blob[GCODE_LINE_BYTECODE];
+    size_t blob_size = 0;
+    if (flags & kHasCondition) blob_size += appendExpression(line, line.condition, blob + blob_size);
+    if (flags & kHasValue) blob_size += appendExpression(line, line.value, blob + blob_size);
+    for (int i = 0; i < GCODE_BINARY_LETTERS; i++) {
+      if (expression_mask & (1UL << i)) blob_size += appendExpression(line, expressions[i], blob + blob_size);
+    }
+    size += putVarint(out + size, expression_mask);
+    size += putVarint(out + size, flags);
+    size += putVarint(out + size, blob_size);
+    memcpy(out + size, blob, blob_size);
+    size += blob_size;
+  }
+  for (int i = 0; i < GCODE_BINARY_LETTERS; i++) {
+    if (!(mask & (1UL << i)) || (expression_mask & (1UL << i))) continue;
+    size += putVarint(out + size, zigzag(values[i] - state.last[i]));
+    state.last[i] = values[i];
+  }
+  return size;
+}
+
+// Offset de la prochaine expression du bloc ; false si le bloc est corrompu
+static bool nextExpression(const TokenizedLine &line, size_t &pos, uint8_t &offset) {
+  size_t len = gcodeExpressionLength(line.bytecode + pos, line.code_size - pos);
+  if (len == 0) return false;
+  offset = static_cast<uint8_t>(pos);
+  pos += len;
+  return true;
+}
+
+int decodeGcodeRecord(const uint8_t *data, size_t len, GcodeBinaryState &state, TokenizedLine &line) {
+  uint64_t opcode, mask, delta, expression_mask = 0, flags = 0, blob_size = 0;
+  int used = getVarint(data, len, opcode);
+  if (used <= 0) return used;
+  size_t pos = used;
+  used = getVarint(data + pos, len - pos, mask);
+  if (used <= 0) return used;
+  pos += used;
+  if (mask >> (GCODE_BINARY_LETTERS + 1)) return -1;
+
+  line.condition = line.value = GCODE_NO_EXPRESSION;
+  line.code_size = 0;
+  if (mask & GCODE_BINARY_HAS_EXPRESSIONS) {
+    used = getVarint(data + pos, len - pos, expression_mask);
+    if (used <= 0) return used;
+    pos += used;
+    used = getVarint(data + pos, len - pos, flags);
+    if (used <= 0) return used;
+    pos += used;
+    used = getVarint(data + pos, len - pos, blob_size);
+    if (used <= 0) return used;
+    pos += used;
+    if (blob_size > GCODE_LINE_BYTECODE || (expression_mask & ~mask)) return -1;
+    if (len - pos < blob_size) return 0;
+    memcpy(line.bytecode, data + pos, blob_size);
+    line.code_size = static_cast<uint8_t>(blob_size);
+    pos += blob_size;
+  }
+  if (((opcode & 3) == 3) != ((flags & kHasValue) != 0)) return -1;
+
+  // Les deltas ne sont appliqués qu'une fois l'enregistrement complet
+  int64_t values[GCODE_BINARY_LETTERS];
+  for (int i = 0; i < GCODE_BINARY_LETTERS; i++) {
+    if (!(mask & (1ULL << i)) || (expression_mask & (1ULL << i))) continue;
+    used = getVarint(data + pos, len - pos, delta);
+    if (used <= 0) return used;
+    pos += used;
+    values[i] = state.last[i] + unzigzag(delta);
+  }
+
+  line.type = kTypes[opcode & 3];
+  line.code = static_cast<int>(opcode >> 2);
+  line.count = 0;
+  size_t expression = 0;
+  if ((flags & kHasCondition) && !nextExpression(line, expression, line.condition)) return -1;
+  if ((flags & kHasValue) && !nextExpression(line, expression, line.value)) return -1;
+  for (int i = 0; i < GCODE_BINARY_LETTERS; i++) {
+    if (!(mask & (1ULL << i))) continue;
+    GcodeWord &word = line.words[line.count++];
+    word.letter = kLetters[i];
+    if (expression_mask & (1ULL << i)) {
+      if (!nextExpression(line, expression, word.expression)) return -1;
+      word.value.mantissa = 0;
+      word.value.decimals = 0;
+    } else {
+      state.last[i] = values[i];
+      word.expression = GCODE_NO_EXPRESSION;
+      word.value = fromScaled(values[i], kScales[i]);
+    }
+  }
+  return static_cast<int>(pos);
+}
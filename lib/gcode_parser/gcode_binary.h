@@ -0,0 +1,44 @@
+#pragma once
+
+// G-code binaire pré-découpé (.gcb) : évite tout traitement de texte à l'impression.
+//
+// Fichier : en-tête de 16 octets puis une suite d'enregistrements
+//   en-tête      : "GCB1", version (u16), taille d'en-tête (u16), nombre de commandes (u32), réservé (u32)
+//   enregistrement : varint opcode ((code << 2) | 0 'G', 1 'M', 2 'O', 3 '#'), varint masque des
+//                    lettres présentes, [bloc d'expressions], puis pour chaque lettre littérale un
+//                    varint zigzag du delta de sa valeur entière mise à l'échelle par rapport à sa
+//                    valeur précédente dans le fichier.
+//   bloc d'expressions (bit GCODE_BINARY_HAS_EXPRESSIONS du masque) : varint masque des lettres
+//                    dont la valeur est une expression, varint drapeaux (1 : condition IF,
+//                    2 : valeur affectée), varint taille, puis le bytecode dans l'ordre
+//                    condition, valeur affectée, lettres.
+// Sans dépendance Arduino : partagé par le firmware et tools/gcode2bin. Sert aussi de
+// stockage compact des corps de sous-programmes mis en cache par le parser.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gcode_tokenizer.h"
+
+#define GCODE_BINARY_MAGIC "GCB1"
+#define GCODE_BINARY_EXTENSION ".gcb" // Un fichier .gcb sans en-tête valide est refusé
+#define GCODE_BINARY_VERSION 3 // 2 : mots O, P et L (sous-programmes), 3 : expressions
+#define GCODE_BINARY_HEADER_SIZE 16
+#define GCODE_BINARY_LETTERS 11     // X Y Z E F S I J R P L
+#define GCODE_BINARY_HAS_EXPRESSIONS (1UL << GCODE_BINARY_LETTERS)
+#define GCODE_BINARY_MAX_RECORD 240 // En-tête, bloc d'expressions et 11 valeurs de 10 octets au plus
+
+// Dernières valeurs codées par lettre (références des deltas)
+struct GcodeBinaryState {
+  int64_t last[GCODE_BINARY_LETTERS];
+  void reset();
+};
+
+void writeGcodeBinaryHeader(uint8_t *out, uint32_t command_count);
+bool readGcodeBinaryHeader(const uint8_t *data, size_t len, uint32_t &command_count);
+
+// Encode une ligne découpée ; retourne la taille écrite, 0 si une lettre n'est pas codable
+size_t encodeGcodeRecord(const TokenizedLine &line, GcodeBinaryState &state, uint8_t *out);
+
+// Décode un enregistrement ; retourne les octets consommés, 0 si les données sont
+// incomplètes, -1 si l'enregistrement est corrompu
+int decodeGcodeRecord(const uint8_t *data, size_t len, GcodeBinaryState &state, TokenizedLine &line);
@@ -0,0 +1,263 @@
+#include "gcode_expression.h"
+#include "gcode_number.h"
+#include <math.h>
+#include <string.h>
+
+enum ExpressionOp : uint8_t {
+  OP_END, OP_CONST, OP_VAR, OP_NEG,
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+  OP_EQ, OP_NE, OP_GT, OP_GE, OP_LT, OP_LE, OP_AND, OP_OR,
+  OP_ABS, OP_SQRT, OP_SIN, OP_COS, OP_ROUND, OP_FIX,
+  OP_COUNT
+};
+
+static const int kMaxNesting = 8;
+static const float kDegreesToRadians = 0.0174532925f;
+static const float kEqualTolerance = 1e-6f;
+
+struct Keyword {
+  const char *name;
+  uint8_t op;
+};
+
+static const Keyword kComparisons[] = {
+  {"EQ", OP_EQ}, {"NE", OP_NE}, {"GT", OP_GT}, {"GE", OP_GE}, {"LT", OP_LT}, {"LE", OP_LE}
+};
+static const Keyword kFunctions[] = {
+  {"ABS", OP_ABS}, {"SQRT", OP_SQRT}, {"SIN", OP_SIN}, {"COS", OP_COS}, {"ROUND", OP_ROUND}, {"FIX", OP_FIX}
+};
+
+// État de compilation : sortie bornée et profondeur de pile simulée
+struct ExpressionCompiler {
+  const char *p;
+  const char *end;
+  uint8_t *code;
+  uint8_t size;
+  uint8_t capacity;
+  int depth;
+  int nesting;
+
+  bool emit(uint8_t byte) {
+    if (size == capacity) return false;
+    code[size++] = byte;
+    return true;
+  }
+  // Mise à jour de la profondeur de pile : push = +1, opérateur binaire = -1
+  bool stack(int delta) {
+    depth += delta;
+    return depth <= GCODE_EXPRESSION_STACK;
+  }
+  void skipBlanks() {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+  }
+  bool keyword(const char *name) {
+    skipBlanks();
+    size_t len = strlen(name);
+    if (static_cast<size_t>(end - p) < len) return false;
+    for (size_t i = 0; i < len; i++) {
+      char c = p[i];
+      if (c >= 'a' && c <= 'z') c = static_cast<char>(c - 'a' + 'A');
+      if (c != name[i]) return false;
+    }
+    p += len;
+    return true;
+  }
+  bool symbol(char c) {
+    skipBlanks();
+    if (p < end && *p == c) {
+      p++;
+      return true;
+    }
+    return false;
+  }
+
+  bool variable();
+  bool unary();
+  bool product();
+  bool sum();
+  bool comparison();
+  bool conjunction();
+  bool expression();
+  bool bracketed();
+};
+
+bool ExpressionCompiler::variable() {
+  if (p == end || *p < '0' || *p > '9') return false;
+  unsigned index = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    index = index * 10 + (*p++ - '0');
+    if (index >= GCODE_VARIABLE_COUNT) return false;
+  }
+  return emit(OP_VAR) && emit(static_cast<uint8_t>(index)) && stack(1);
+}
+
+bool ExpressionCompiler::bracketed() {
+  if (!symbol('[') || ++nesting > kMaxNesting) return false;
+  bool ok = expression() && symbol(']');
+  nesting--;
+  return ok;
+}
+
+bool ExpressionCompiler::unary() {
+  if (symbol('-')) return unary() && emit(OP_NEG);
+  if (symbol('+')) return unary();
+  skipBlanks();
+  if (p == end) return false;
+  if (*p == '#') {
+    p++;
+    return variable();
+  }
+  if (*p == '[') return bracketed();
+  if (*p == '.' || (*p >= '0' && *p <= '9')) {
+    GcodeDecimal value;
+    if (!scanGcodeDecimal(p, end, value)) return false;
+    float constant = gcodeDecimalToFloat(value);
+    uint8_t bytes[sizeof(float)];
+    memcpy(bytes, &constant, sizeof(bytes));
+    if (!emit(OP_CONST)) return false;
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+      if (!emit(bytes[i])) return false;
+    }
+    return stack(1);
+  }
+  for (size_t i = 0; i < sizeof(kFunctions) / sizeof(kFunctions[0]); i++) {
+    if (keyword(kFunctions[i].name)) return bracketed() && emit(kFunctions[i].op);
+  }
+  return false;
+}
+
+bool ExpressionCompiler::product() {
+  if (!unary()) return false;
+  while (true) {
+    uint8_t op;
+    if (symbol('*')) op = OP_MUL;
+    else if (symbol('/')) op = OP_DIV;
+    else if (keyword("MOD")) op = OP_MOD;
+    else return true;
+    if (!unary() || !emit(op) || !stack(-1)) return false;
+  }
+}
+
+bool ExpressionCompiler::sum() {
+  if (!product()) return false;
+  while (true) {
+    uint8_t op;
+    if (symbol('+')) op = OP_ADD;
+    else if (symbol('-')) op = OP_SUB;
+    else return true;
+    if (!product() || !emit(op) || !stack(-1)) return false;
+  }
+}
+
+bool ExpressionCompiler::comparison() {
+  if (!sum()) return false;
+  for (size_t i = 0; i < sizeof(kComparisons) / sizeof(kComparisons[0]); i++) {
+    if (keyword(kComparisons[i].name)) return sum() && emit(kComparisons[i].op) && stack(-1);
+  }
+  return true;
+}
+
+bool ExpressionCompiler::conjunction() {
+  if (!comparison()) return false;
+  while (keyword("AND")) {
+    if (!comparison() || !emit(OP_AND) || !stack(-1)) return false;
+  }
+  return true;
+}
+
+bool ExpressionCompiler::expression() {
+  if (!conjunction()) return false;
+  while (keyword("OR")) {
+    if (!conjunction() || !emit(OP_OR) || !stack(-1)) return false;
+  }
+  return true;
+}
+
+bool compileGcodeExpression(const char *&p, const char *end, uint8_t *code, uint8_t &size,
+                            uint8_t capacity, bool bare) {
+  ExpressionCompiler compiler = {p, end, code, size, capacity, 0, 0};
+  bool ok;
+  if (bare) {
+    ok = compiler.expression();
+  } else if (compiler.symbol('-')) {
+    ok = (compiler.symbol('#') ? compiler.variable() : compiler.bracketed()) && compiler.emit(OP_NEG);
+  } else {
+    ok = compiler.symbol('#') ? compiler.variable() : compiler.bracketed();
+  }
+  if (!ok || !compiler.emit(OP_END)) return false;
+  p = compiler.p;
+  size = compiler.size;
+  return true;
+}
+
+size_t gcodeExpressionLength(const uint8_t *code, size_t len) {
+  size_t pos = 0;
+  while (pos < len) {
+    uint8_t op = code[pos++];
+    if (op == OP_END) return pos;
+    if (op == OP_CONST) pos += sizeof(float);
+    else if (op == OP_VAR) pos += 1;
+    else if (op >= OP_COUNT) return 0;
+  }
+  return 0;
+}
+
+bool evaluateGcodeExpression(const uint8_t *code, const float *variables, float &result) {
+  float stack[GCODE_EXPRESSION_STACK];
+  int top = -1;
+  while (true) {
+    uint8_t op = *code++;
+    if (op >= OP_ADD && op <= OP_OR) {
+      // Opérateurs binaires : stack[top - 1] op stack[top]
+      if (top < 1) return false;
+      float b = stack[top--];
+      float &a = stack[top];
+      switch (op) {
+        case OP_ADD: a += b; break;
+        case OP_SUB: a -= b; break;
+        case OP_MUL: a *= b; break;
+        case OP_DIV: if (b == 0.0f) return false; a /= b; break;
+        case OP_MOD: if (b == 0.0f) return false; a = fmodf(a, b); break;
+        case OP_EQ: a = fabsf(a - b) <= kEqualTolerance ? 1.0f : 0.0f; break;
+        case OP_NE: a = fabsf(a - b) > kEqualTolerance ? 1.0f : 0.0f; break;
+        case OP_GT: a = a > b ? 1.0f : 0.0f; break;
+        case OP_GE: a = a >= b ? 1.0f : 0.0f; break;
+        case OP_LT: a = a < b ? 1.0f : 0.0f; break;
+        case OP_LE: a = a <= b ? 1.0f : 0.0f; break;
+        case OP_AND: a = (a != 0.0f && b != 0.0f) ? 1.0f : 0.0f; break;
+        case OP_OR: a = (a != 0.0f || b != 0.0f) ? 1.0f : 0.0f; break;
+      }
+      continue;
+    }
+    switch (op) {
+      case OP_END:
+        if (top != 0) return false;
+        result = stack[0];
+        return true;
+      case OP_CONST:
+        if (top == GCODE_EXPRESSION_STACK - 1) return false;
+        memcpy(&stack[++top], code, sizeof(float));
+        code += sizeof(float);
+        break;
+      case OP_VAR:
+        if (top == GCODE_EXPRESSION_STACK - 1) return false;
+        stack[++top] = variables[*code++];
+        break;
+      default: {
+        // Opérateurs unaires
+        if (top < 0) return false;
+        float &a = stack[top];
+        switch (op) {
+          case OP_NEG: a = -a; break;
+          case OP_ABS: a = fabsf(a); break;
+          case OP_SQRT: if (a < 0.0f) return false; a = sqrtf(a); break;
+          case OP_SIN: a = sinf(a * kDegreesToRadians); break;
+          case OP_COS: a = cosf(a * kDegreesToRadians); break;
+          case OP_ROUND: a = roundf(a); break;
+          case OP_FIX: a = floorf(a); break;
+          default: return false;
+        }
+      }
+    }
+  }
+}
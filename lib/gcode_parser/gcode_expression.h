@@ -0,0 +1,32 @@
+#pragma once
+
+// Expressions paramétriques "#1", "[#1 * 0.2 + 5]", "[#2 GT 0.6]" compilées une fois
+// en bytecode pour une machine à pile, puis évaluées sans allocation à chaque exécution
+// (une fois par répétition dans un sous-programme). Sans dépendance Arduino.
+//
+// Grammaire (mots-clés insensibles à la casse, angles en degrés) :
+//   expr    := and { OR and }
+//   and     := cmp { AND cmp }
+//   cmp     := sum [ (EQ|NE|GT|GE|LT|LE) sum ]   -> 1 ou 0
+//   sum     := product { (+|-) product }
+//   product := unary { (*|/|MOD) unary }
+//   unary   := (-|+) unary | nombre | #n | [ expr ] | (ABS|SQRT|SIN|COS|ROUND|FIX) [ expr ]
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define GCODE_VARIABLE_COUNT 256  // Variables #0 à #255
+#define GCODE_EXPRESSION_STACK 8  // Profondeur de pile, vérifiée à la compilation
+#define GCODE_NO_EXPRESSION 0xFF
+
+// Compile une valeur de paramètre ("#3", "-#3", "[...]") à la suite de code[size].
+// Avec bare = true, compile une expression sans crochets (membre droit d'une affectation).
+// Retourne false si l'expression est invalide ou dépasse capacity.
+bool compileGcodeExpression(const char *&p, const char *end, uint8_t *code, uint8_t &size,
+                            uint8_t capacity, bool bare);
+
+// Taille d'une expression compilée, OP_END compris ; 0 si le bytecode est corrompu
+size_t gcodeExpressionLength(const uint8_t *code, size_t len);
+
+// Retourne false sur division par zéro, racine négative ou bytecode corrompu
+bool evaluateGcodeExpression(const uint8_t *code, const float *variables, float &result);
@@ -0,0 +1,77 @@
+#include "gcode_number.h"
+
+// 10^n exacts en simple précision jusqu'à n = 10 (5^10 < 2^24)
+static const float kPow10f[] = {
+  1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+static const int64_t kPow10i[] = {
+  1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+  100000000LL, 1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL
+};
+static const uint32_t kMantissaLimit = 999999999UL;
+
+bool scanGcodeDecimal(const char *&p, const char *end, GcodeDecimal &out) {
+  const char *s = p;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+')) {
+    negative = (*s == '-');
+    s++;
+  }
+  uint32_t mantissa = 0;
+  uint8_t decimals = 0;
+  uint8_t digits = 0;
+  bool any_digit = false;
+
+  while (s < end && *s >= '0' && *s <= '9') {
+    if (mantissa != 0 || *s != '0') {
+      if (++digits > GCODE_DECIMAL_MAX_DIGITS) return false; // Partie entière trop grande
+    }
+    mantissa = mantissa * 10 + (*s - '0');
+    any_digit = true;
+    s++;
+  }
+  if (s < end && *s == '.') {
+    s++;
+    while (s < end && *s >= '0' && *s <= '9') {
+      any_digit = true;
+      if (mantissa <= (kMantissaLimit - (*s - '0')) / 10 && decimals < 12) {
+        mantissa = mantissa * 10 + (*s - '0');
+        decimals++;
+      }
+      s++; // Décimales au-delà de la précision : tronquées
+    }
+  }
+  if (!any_digit) return false;
+
+  out.mantissa = negative ? -static_cast<int32_t>(mantissa) : static_cast<int32_t>(mantissa);
+  out.decimals = decimals;
+  p = s;
+  return true;
+}
+
+int32_t gcodeDecimalToScaled(const GcodeDecimal &value, uint8_t scale) {
+  int64_t result;
+  if (scale >= value.decimals) {
+    uint8_t shift = scale - value.decimals;
+    if (shift > 12) shift = 12;
+    result = static_cast<int64_t>(value.mantissa) * kPow10i[shift];
+  } else {
+    int64_t divisor = kPow10i[value.decimals - scale];
+    int64_t half = divisor / 2;
+    result = value.mantissa >= 0 ? (value.mantissa + half) / divisor
+                                 : (value.mantissa - half) / divisor;
+  }
+  if (result > INT32_MAX) return INT32_MAX;
+  if (result < INT32_MIN) return INT32_MIN;
+  return static_cast<int32_t>(result);
+}
+
+float gcodeDecimalToFloat(const GcodeDecimal &value) {
+  int32_t m = value.mantissa;
+  if (value.decimals == 0) return static_cast<float>(m);
+  // Chemin rapide : mantisse et diviseur exacts en float, une seule division correctement arrondie
+  if (m > -(1L << 24) && m < (1L << 24) && value.decimals <= 10) {
+    return static_cast<float>(m) / kPow10f[value.decimals];
+  }
+  return static_cast<float>(static_cast<double>(m) / static_cast<double>(kPow10i[value.decimals]));
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Nombre décimal G-code décodé sans perte : valeur = mantissa / 10^decimals
+struct GcodeDecimal {
+  int32_t mantissa;
+  uint8_t decimals;
+};
+
+// Nombre maximal de chiffres significatifs conservés (au-delà, les décimales sont tronquées)
+#define GCODE_DECIMAL_MAX_DIGITS 9
+
+// Décode [+-]chiffres[.chiffres] à partir de p sans dépasser end ; p avance après le nombre.
+// Retourne false si aucun chiffre n'est lu ou si la partie entière dépasse 9 chiffres.
+bool scanGcodeDecimal(const char *&p, const char *end, GcodeDecimal &out);
+
+// Conversion exacte vers un entier mis à l'échelle 10^scale (ex. scale 3 : mm -> µm),
+// arrondi au plus proche et saturé sur int32
+int32_t gcodeDecimalToScaled(const GcodeDecimal &value, uint8_t scale);
+
+// Conversion flottante : correctement arrondie tant que |mantissa| < 2^24 (cas courant),
+// erreur bornée à 1 ulp sinon
+float gcodeDecimalToFloat(const GcodeDecimal &value);
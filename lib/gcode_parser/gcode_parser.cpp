@@ -1,13 +1,384 @@
-
 #include "gcode_parser.h"
 #include "../debug_manager.h"
 #include "system_manager.h"
+#include "motion_queue.h"
+#include "../config.h"
 
 GcodeParser gcodeParser;
+static FlowControl gcodeFlow;
+
+static size_t gcodeQueueLevel() {
+  return uxQueueMessagesWaiting(gcodeQueue);
+}
+
+bool sendGcodeLine(LineSlab *slab, TickType_t ticks_to_wait) {
+  if (!gcodeFlow.admit(gcodeQueueLevel, ticks_to_wait)) return false;
+  return xQueueSend(gcodeQueue, &slab, ticks_to_wait) == pdTRUE;
+}
+
+void clearGcodeQueue() {
+  linePool.drain(gcodeQueue);
+  gcodeFlow.release();
+}
+
+// Table de dispatch : ajouter une commande = ajouter une ligne
+const GcodeParser::CommandDescriptor GcodeParser::commandTable[] = {
+  // type, code, autorisés, requis, au moins un de, effet modal, transmise, traitement
+  {'G', 0,   PARAM_XYZE | PARAM_F, 0,       PARAM_XYZE | PARAM_F, ModalEffect::NONE,               true,  &GcodeParser::handleMove},
+  {'G', 1,   PARAM_XYZE | PARAM_F, 0,       PARAM_XYZE | PARAM_F, ModalEffect::NONE,               true,  &GcodeParser::handleMove},
+  {'G', 2,   PARAM_XYZE | PARAM_F | PARAM_I | PARAM_J | PARAM_R, 0, PARAM_I | PARAM_J | PARAM_R, ModalEffect::NONE, true, &GcodeParser::handleArc},
+  {'G', 3,   PARAM_XYZE | PARAM_F | PARAM_I | PARAM_J | PARAM_R, 0, PARAM_I | PARAM_J | PARAM_R, ModalEffect::NONE, true, &GcodeParser::handleArc},
+  {'G', 28,  PARAM_XYZ,            0,       0,                    ModalEffect::NONE,               true,  &GcodeParser::handleHoming},
+  {'G', 90,  0,                    0,       0,                    ModalEffect::ABSOLUTE,           false, nullptr},
+  {'G', 91,  0,                    0,       0,                    ModalEffect::RELATIVE,           false, nullptr},
+  {'G', 20,  0,                    0,       0,                    ModalEffect::INCH,               false, nullptr},
+  {'G', 21,  0,                    0,       0,                    ModalEffect::METRIC,             false, nullptr},
+  {'G', 92,  PARAM_XYZE,           0,       PARAM_XYZE,           ModalEffect::NONE,               false, &GcodeParser::handleSetPosition},
+  {'M', 82,  0,                    0,       0,                    ModalEffect::ABSOLUTE_EXTRUSION, false, nullptr},
+  {'M', 83,  0,                    0,       0,                    ModalEffect::RELATIVE_EXTRUSION, false, nullptr},
+  {'M', 104, PARAM_S,              PARAM_S, 0,                    ModalEffect::NONE,               true,  &GcodeParser::handleThermal},
+  {'M', 109, PARAM_S,              PARAM_S, 0,                    ModalEffect::NONE,               true,  &GcodeParser::handleThermal},
+  {'M', 140, PARAM_S,              PARAM_S, 0,                    ModalEffect::NONE,               true,  &GcodeParser::handleThermal},
+  {'M', 190, PARAM_S,              PARAM_S, 0,                    ModalEffect::NONE,               true,  &GcodeParser::handleThermal},
+  {'M', 106, PARAM_S,              PARAM_S, 0,                    ModalEffect::NONE,               true,  &GcodeParser::handleThermal},
+  {'M', 107, 0,                    0,       0,                    ModalEffect::NONE,               true,  &GcodeParser::handleThermal},
+};
+static const uint32_t kAxisParams[AXIS_COUNT] = {PARAM_X, PARAM_Y, PARAM_Z, PARAM_E};
+static const float kMillimetersPerInch = 25.4f;
+static const float kTwoPi = 6.28318531f;
+
+const size_t GcodeParser::commandCount = sizeof(commandTable) / sizeof(commandTable[0]);
 
 void GcodeParser::init() {
   DEBUG_PRINTF_AUTO("Initialisation du Gcode Parser");
-  absolute_positioning = true; // G90 par défaut
+  resetModalState();
+  if (!state_mutex) state_mutex = xSemaphoreCreateMutex();
+  if (!gcodeFlow.init(GCODE_QUEUE_HIGH_WATERMARK, GCODE_QUEUE_LOW_WATERMARK)) {
+    DEBUG_PRINTF_AUTO("Erreur: Création du sémaphore de gcodeQueue impossible");
+  }
+}
+
+bool GcodeParser::lock(TickType_t ticks_to_wait) {
+  return !state_mutex || xSemaphoreTake(state_mutex, ticks_to_wait) == pdTRUE;
+}
+
+void GcodeParser::unlock() {
+  if (state_mutex) xSemaphoreGive(state_mutex);
+}
+
+void GcodeParser::resetProgram() {
+  program_generation++;
+  subroutines.clear();
+  call_depth = 0;
+  memset(variables, 0, sizeof(variables));
+  program_state = false;
+}
+
+void GcodeParser::resetModalState() {
+  memset(&modal, 0, sizeof(modal));
+  modal.absolute = true; // G90, G21 et M82 par défaut
+}
+
+// Reprise en cours de fichier : la prochaine commande de mouvement porte sa vitesse
+void GcodeParser::restoreModalState(const ModalState &state) {
+  modal = state;
+  modal.emitted_feedrate = -1.0f;
+}
+
+void GcodeParser::buildDispatchIndex() {
+  memset(dispatch_index, NO_DESCRIPTOR, sizeof(dispatch_index));
+  for (size_t i = 0; i < commandCount; i++) {
+    const CommandDescriptor &desc = commandTable[i];
+    dispatch_index[desc.type == 'M' ? 1 : 0][desc.code] = static_cast<uint8_t>(i);
+  }
+}
+
+const GcodeParser::CommandDescriptor *GcodeParser::findDescriptor(char type, int code) const {
+  if (code < 0 || code >= DISPATCH_CODES) return nullptr;
+  uint8_t index = dispatch_index[type == 'M' ? 1 : 0][code];
+  return index == NO_DESCRIPTOR ? nullptr : &commandTable[index];
+}
+
+// Chemin unique partagé par parserTask et testParse : découpe puis processWords
+ParseStatus GcodeParser::parseLine(const char *line, size_t len, MotionCommand &cmd) {
+  size_t column;
+  TokenizedLine words;
+  TokenStatus token = tokenizeWords(line, len, words, column);
+  if (token == TokenStatus::OK) return processWords(words, cmd);
+  if (token == TokenStatus::EMPTY) return ParseStatus::CONSUMED; // Ligne vide ou commentaire seul
+
+  // Cause et colonne conservées pour le journal d'erreurs, sans impression par ligne
+  error_code = static_cast<ParseErrorCode>(token);
+  error_column = static_cast<uint16_t>(column);
+  return token == TokenStatus::BAD_COMMAND ? ParseStatus::INVALID_TYPE : ParseStatus::INVALID;
+}
+
+ParseErrorCode GcodeParser::errorCode(ParseStatus status) const {
+  if (status == ParseStatus::OK || status == ParseStatus::CONSUMED) return ParseErrorCode::NONE;
+  if (error_code != ParseErrorCode::NONE) return error_code;
+  switch (status) {
+    case ParseStatus::INVALID_TYPE: return ParseErrorCode::BAD_COMMAND;
+    case ParseStatus::UNSUPPORTED: return ParseErrorCode::UNSUPPORTED;
+    case ParseStatus::INVALID: return ParseErrorCode::INVALID_COMMAND;
+    default: return ParseErrorCode::NONE;
+  }
+}
+
+// Erreur d'une ligne de fichier : enregistrée selon la politique, sans sortie série
+// sauf à l'abandon. Retourne false si le fichier est (ou était déjà) abandonné.
+bool GcodeParser::recordError(ParseErrorCode code, uint16_t column, uint32_t line, uint32_t offset) {
+  if (parseErrors.isAborted()) return false;
+  if (parseErrors.report(code, line, offset, column)) return true;
+  discardMotion(); // Le mouvement retenu appartient au fichier abandonné
+  DEBUG_PRINTF_AUTO("Erreur ligne %lu colonne %u: %s, fichier abandonné",
+                    (unsigned long)line, column + 1, parseErrorMessage(code));
+  if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+  Serial.printf("ERROR: Parse error at line %lu, column %u (code %u), file aborted\n",
+                (unsigned long)line, column + 1, static_cast<unsigned>(code));
+  return false;
+}
+
+// Résumé unique en fin de fichier : une ligne sur la liaison série, le détail en debug.
+// Lignes sautées ou comptées n'arrêtent pas la machine : seul l'abandon (recordError)
+// signale errorSemaphore.
+void GcodeParser::summarizeErrors() {
+  uint32_t total = parseErrors.count();
+  if (total == 0 || parseErrors.isAborted()) return; // Abandon déjà signalé
+  ParseErrorRecord records[PARSE_ERROR_RING_SIZE];
+  uint8_t count = parseErrors.recent(records, PARSE_ERROR_RING_SIZE);
+  for (uint8_t n = 0; n < count; n++) {
+    DEBUG_PRINTF_AUTO("Erreur ligne %lu colonne %u (octet %lu): %s", (unsigned long)records[n].line,
+                      records[n].column + 1, (unsigned long)records[n].offset, parseErrorMessage(records[n].code));
+  }
+  const ParseErrorRecord &first = parseErrors.first();
+  Serial.printf("ERROR: %lu parse errors, first at line %lu, column %u (code %u)\n", (unsigned long)total,
+                (unsigned long)first.line, first.column + 1, static_cast<unsigned>(first.code));
+}
+
+// Ligne découpée (texte, G-code binaire ou corps de sous-programme) : sous-programmes,
+// conditions et affectations sont traités ici, au niveau des mots, le reste passe par
+// processCommand. Les expressions d'un corps en cours de définition ne sont évaluées
+// qu'à son exécution, avec les variables du moment.
+ParseStatus GcodeParser::processWords(const TokenizedLine &words, MotionCommand &cmd) {
+  if (call_depth == 0) {
+    error_code = ParseErrorCode::NONE;
+    error_column = 0;
+  }
+  cmd.type = words.type;
+  cmd.code = words.code;
+  bool end_of_subroutine = words.type == 'M' && words.code == 99;
+
+  // Définition en cours : les lignes sont mises en cache sans être exécutées
+  if (subroutines.isRecording()) {
+    if (end_of_subroutine) {
+      subroutines.end();
+      return ParseStatus::CONSUMED;
+    }
+    if (words.type == 'O' || !subroutines.append(words)) {
+      DEBUG_PRINTF_AUTO("Erreur: Définition de sous-programme abandonnée sur %c%d", words.type, words.code);
+      subroutines.abort();
+      return ParseStatus::INVALID;
+    }
+    return ParseStatus::CONSUMED;
+  }
+
+  if (words.condition != GCODE_NO_EXPRESSION) {
+    float condition;
+    if (!evaluateGcodeExpression(words.bytecode + words.condition, variables, condition)) {
+      DEBUG_PRINTF_AUTO("Erreur: Condition IF non évaluable");
+      return ParseStatus::INVALID;
+    }
+    if (condition == 0.0f) return ParseStatus::CONSUMED;
+  }
+  if (words.type == '#') {
+    program_state = true;
+    if (!evaluateGcodeExpression(words.bytecode + words.value, variables, variables[words.code])) {
+      DEBUG_PRINTF_AUTO("Erreur: Affectation #%d non évaluable", words.code);
+      return ParseStatus::INVALID;
+    }
+    return ParseStatus::CONSUMED;
+  }
+  if (words.type == 'O') {
+    program_state = true;
+    if (words.count != 0 || !subroutines.begin(words.code)) {
+      DEBUG_PRINTF_AUTO("Erreur: Impossible de définir O%d", words.code);
+      return ParseStatus::INVALID;
+    }
+    return ParseStatus::CONSUMED;
+  }
+  if (words.type == 'M' && words.code == 98) return callSubroutine(words);
+  if (end_of_subroutine) {
+    DEBUG_PRINTF_AUTO("Erreur: M99 hors d'une définition de sous-programme");
+    return ParseStatus::INVALID;
+  }
+
+  TokenStatus token = wordsToCommand(words, cmd, variables);
+  if (token != TokenStatus::OK) {
+    error_code = static_cast<ParseErrorCode>(token);
+    return ParseStatus::INVALID;
+  }
+  return processCommand(cmd);
+}
+
+// M98 P<n> [L<répétitions>] [Z<décalage>] : rejoue le corps pré-découpé de O<n>. Chaque
+// répétition ajoute Z au décalage G92 de l'axe Z (murs identiques empilés), retiré au
+// retour. Le corps doit donc fixer Z en absolu, et utiliser M83 ou G92 E0 pour l'extrusion.
+ParseStatus GcodeParser::callSubroutine(const TokenizedLine &words) {
+  long number = -1, repeat = 1;
+  float shift = 0.0f;
+  for (uint8_t n = 0; n < words.count; n++) {
+    const GcodeWord &word = words.words[n];
+    float value;
+    if (!wordValue(words, word, variables, value)) return ParseStatus::INVALID;
+    if (word.letter == 'P') number = lroundf(value);
+    else if (word.letter == 'L') repeat = lroundf(value);
+    else if (word.letter == 'Z') shift = value;
+    else return ParseStatus::INVALID;
+  }
+  const Subroutine *sub = number >= 0 ? subroutines.find(number) : NULL;
+  if (!sub || repeat < 1) {
+    DEBUG_PRINTF_AUTO("Erreur: Appel M98 invalide (O%ld, L%ld)", number, repeat);
+    return ParseStatus::INVALID;
+  }
+  if (call_depth == SUBROUTINE_MAX_DEPTH) {
+    DEBUG_PRINTF_AUTO("Erreur: Imbrication M98 limitée à %d niveaux", SUBROUTINE_MAX_DEPTH);
+    return ParseStatus::INVALID;
+  }
+  if (modal.inches) shift *= kMillimetersPerInch;
+
+  call_depth++;
+  uint32_t generation = program_generation;
+  ParseStatus result = ParseStatus::CONSUMED;
+  long shifted = 0;
+  for (long k = 0; k < repeat && result == ParseStatus::CONSUMED; k++) {
+    if (k > 0) {
+      modal.offset[AXIS_Z] += shift;
+      shifted++;
+    }
+    GcodeBinaryState state;
+    state.reset();
+    size_t pos = 0;
+    while (pos < sub->size) {
+      TokenizedLine line;
+      int used = decodeGcodeRecord(sub->records + pos, sub->size - pos, state, line);
+      if (used <= 0) {
+        result = ParseStatus::INVALID;
+        break;
+      }
+      pos += used;
+      MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+      ParseStatus status = processWords(line, cmd);
+      if (status == ParseStatus::OK) {
+        if (!emitCommand(cmd)) {
+          k = repeat; // Échec déjà signalé par emitCommand
+          break;
+        }
+        // Verrou rendu pendant l'attente de motionQueue : un resetProgram() d'une autre
+        // tâche a pu libérer le corps en cours
+        if (generation != program_generation) {
+          DEBUG_PRINTF_AUTO("Erreur: O%ld effacé pendant son exécution", number);
+          result = ParseStatus::INVALID;
+          break;
+        }
+      } else if (status != ParseStatus::CONSUMED) {
+        DEBUG_PRINTF_AUTO("Erreur: %c%d rejetée dans O%ld (répétition %ld)", cmd.type, cmd.code, number, k + 1);
+        result = status;
+        break;
+      }
+    }
+  }
+  modal.offset[AXIS_Z] -= shift * shifted;
+  call_depth--;
+  return result;
+}
+
+// Commande déjà découpée (texte ou G-code binaire) : recherche, validation, effet modal
+ParseStatus GcodeParser::processCommand(MotionCommand &cmd) {
+  arc.segments = arc.current = 0; // Un arc non vidé par l'appelant est abandonné
+  const CommandDescriptor *desc = findDescriptor(cmd.type, cmd.code);
+  if (!desc) return ParseStatus::UNSUPPORTED;
+
+  if ((cmd.params & ~desc->allowed) != 0 || (cmd.params & desc->required) != desc->required ||
+      (desc->required_any != 0 && (cmd.params & desc->required_any) == 0)) {
+    DEBUG_PRINTF_AUTO("Erreur: Paramètres invalides pour %c%d (masque 0x%08lx)",
+                      cmd.type, cmd.code, (unsigned long)cmd.params);
+    return ParseStatus::INVALID;
+  }
+
+  applyModalEffect(desc->modal);
+  ParseStatus status = desc->handler ? (this->*(desc->handler))(cmd) : ParseStatus::OK;
+  if (status == ParseStatus::OK && !desc->emit) status = ParseStatus::CONSUMED;
+  return status;
+}
+
+// Verrou pris par l'appelant. File pleine : l'attente se fait verrou rendu, pour que
+// TEST_PARSE, un départ indexé ou un point de reprise ne restent pas bloqués derrière le
+// consommateur ; l'envoi lui-même a toujours lieu verrou pris (un seul producteur).
+bool GcodeParser::sendMotion(const MotionCommand &cmd) {
+  MotionQueueItem item;
+  toMotionQueueItem(cmd, item);
+  while (!motionQueue.send(item, 0)) {
+    unlock();
+    bool space = motionQueue.waitForSpace(pdMS_TO_TICKS(5000));
+    lock();
+    if (space) continue;
+    DEBUG_PRINTF_AUTO("Erreur: Impossible d'envoyer à motionQueue après 5s");
+    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    Serial.println("ERROR: Failed to send to motionQueue");
+    return false;
+  }
+  DEBUG_PRINTF_AUTO("Commande envoyée à motionQueue: %c%d", cmd.type, cmd.code);
+  return true;
+}
+
+// Envoie une commande validée à motionQueue, suivie des segments restants d'un arc.
+// L'envoi bloquant régule la génération des segments. Avec MOTION_MERGE_SEGMENTS, les
+// G0/G1 passent par l'étage de fusion et le dernier peut rester en attente.
+bool GcodeParser::emitCommand(MotionCommand &cmd) {
+  if (dry_run) {
+    // Segments restants non produits : l'état modal passe directement à la fin de l'arc
+    if (arc.current < arc.segments) memcpy(modal.position, arc.end, sizeof(modal.position));
+    arc.segments = arc.current = 0;
+    return true;
+  }
+  do {
+#if MOTION_MERGE_SEGMENTS
+    MotionCommand ready[2];
+    uint8_t count = merger.push(cmd, ready);
+    for (uint8_t n = 0; n < count; n++) {
+      if (!sendMotion(ready[n])) {
+        arc.segments = arc.current = 0;
+        return false;
+      }
+    }
+#else
+    if (!sendMotion(cmd)) {
+      arc.segments = arc.current = 0;
+      return false;
+    }
+#endif
+  } while (nextArcSegment(cmd));
+  return true;
+}
+
+bool GcodeParser::flushMotion() {
+  MotionCommand cmd;
+  if (!merger.flush(cmd)) return true;
+  DEBUG_PRINTF_AUTO("Fusion: %lu segments absorbés, %lu abandonnés depuis le démarrage",
+                    (unsigned long)merger.mergedCount(), (unsigned long)merger.droppedCount());
+  return sendMotion(cmd);
+}
+
+void GcodeParser::applyModalEffect(ModalEffect effect) {
+  switch (effect) {
+    case ModalEffect::ABSOLUTE: modal.absolute = true; break;
+    case ModalEffect::RELATIVE: modal.absolute = false; break;
+    case ModalEffect::METRIC: modal.inches = false; break;
+    case ModalEffect::INCH: modal.inches = true; break;
+    case ModalEffect::ABSOLUTE_EXTRUSION: modal.relative_extrusion = false; break;
+    case ModalEffect::RELATIVE_EXTRUSION: modal.relative_extrusion = true; break;
+    case ModalEffect::NONE: break;
+  }
 }
 
 void GcodeParser::testParse(String cmd) {
@@ -19,232 +390,361 @@ void GcodeParser::testParse(String cmd) {
   }
   DEBUG_PRINTF_AUTO("Test: Parsing commande '%s'", cmd.c_str());
 
-  MotionCommand parsed_cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, false, false, false, false, false, false};
-  int space_pos = cmd.indexOf(' ');
-  String params = (space_pos == -1) ? "" : cmd.substring(space_pos + 1);
-  String code_str = cmd.substring(0, space_pos == -1 ? cmd.length() : space_pos);
-
-  if (!code_str.startsWith("G") && !code_str.startsWith("M")) {
-    DEBUG_PRINTF_AUTO("Test: Type de commande inconnu '%s'", code_str.c_str());
-    Serial.println("ERROR: Invalid command type");
-    return;
-  }
-
-  parsed_cmd.type = code_str.charAt(0);
-  parsed_cmd.code = code_str.substring(1).toInt();
+  // La ligne d'essai part de l'état courant, en dry run, sur le parser lui-même : état
+  // modal, consignes et arc sont restaurés ensuite, si bien que G91, G92 ou un G2 d'essai
+  // ne changent rien pour l'impression, y compris pour un arc dont l'envoi attend de la
+  // place dans motionQueue verrou rendu.
+  MotionCommand parsed_cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+  int segments = 1;
+  lock();
+  ModalState saved_modal = modal;
+  ThermalState saved_thermal = thermal;
+  ArcState saved_arc = arc;
+  bool saved_dry_run = dry_run;
+  dry_run = true;
+  size_t column;
+  TokenizedLine words;
+  TokenStatus token = tokenizeWords(cmd.c_str(), cmd.length(), words, column);
+  ParseStatus status;
+  if (token == TokenStatus::OK) status = testWords(words, parsed_cmd);
+  else if (token == TokenStatus::EMPTY) status = ParseStatus::CONSUMED;
+  else status = token == TokenStatus::BAD_COMMAND ? ParseStatus::INVALID_TYPE : ParseStatus::INVALID;
+  while (nextArcSegment(parsed_cmd)) segments++;
+  modal = saved_modal;
+  thermal = saved_thermal;
+  arc = saved_arc;
+  dry_run = saved_dry_run;
+  unlock();
 
-  bool valid = false;
-  switch (static_cast<GcodeType>(parsed_cmd.code)) {
-    case GcodeType::G0:
-    case GcodeType::G1:
-      valid = gcodeParser.parseMovementCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+  switch (status) {
+    case ParseStatus::OK:
+    case ParseStatus::CONSUMED: {
+      DEBUG_PRINTF_AUTO("Test: Commande valide, type=%c, code=%d, segments=%d",
+                        parsed_cmd.type, parsed_cmd.code, segments);
+      Serial.println("OK: Command parsed");
       break;
-    case GcodeType::G28:
-      valid = gcodeParser.parseHomingCommand(params, parsed_cmd);
-      break;
-    case GcodeType::G90:
-    case GcodeType::G91:
-    case GcodeType::G21:
-      valid = gcodeParser.parsePositioningCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
-      break;
-    case GcodeType::M104:
-    case GcodeType::M109:
-    case GcodeType::M140:
-    case GcodeType::M190:
-      valid = gcodeParser.parseTemperatureCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
-      break;
-    case GcodeType::M106:
-    case GcodeType::M107:
-      valid = gcodeParser.parseFanCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+    }
+    case ParseStatus::INVALID_TYPE:
+      DEBUG_PRINTF_AUTO("Test: Type de commande inconnu '%s'", cmd.c_str());
+      Serial.println("ERROR: Invalid command type");
       break;
-    default:
+    case ParseStatus::UNSUPPORTED:
       DEBUG_PRINTF_AUTO("Test: Code %c%d non supporté", parsed_cmd.type, parsed_cmd.code);
       Serial.println("ERROR: Unsupported command");
-      return;
+      break;
+    case ParseStatus::INVALID:
+      DEBUG_PRINTF_AUTO("Test: Erreur parsing '%s'", cmd.c_str());
+      Serial.println("ERROR: Invalid command");
+      break;
   }
+}
 
-  if (valid) {
-    DEBUG_PRINTF_AUTO("Test: Commande valide, type=%c, code=%d", parsed_cmd.type, parsed_cmd.code);
-    Serial.println("OK: Command parsed");
-  } else {
-    DEBUG_PRINTF_AUTO("Test: Erreur parsing '%s'", cmd.c_str());
-    Serial.println("ERROR: Invalid command");
+// Ligne de TEST_PARSE : comme processWords, sans toucher au programme. Une affectation
+// est évaluée sans être écrite, O<n> seulement validé ; les sous-programmes du fichier en
+// cours ne sont pas rejoués, un M98 ou M99 d'essai est donc refusé.
+ParseStatus GcodeParser::testWords(const TokenizedLine &words, MotionCommand &cmd) {
+  cmd.type = words.type;
+  cmd.code = words.code;
+  if (words.condition != GCODE_NO_EXPRESSION) {
+    float condition;
+    if (!evaluateGcodeExpression(words.bytecode + words.condition, variables, condition)) return ParseStatus::INVALID;
+    if (condition == 0.0f) return ParseStatus::CONSUMED;
   }
+  if (words.type == '#') {
+    float value;
+    return evaluateGcodeExpression(words.bytecode + words.value, variables, value) ? ParseStatus::CONSUMED
+                                                                                    : ParseStatus::INVALID;
+  }
+  if (words.type == 'O') return words.count == 0 ? ParseStatus::CONSUMED : ParseStatus::INVALID;
+  if (words.type == 'M' && (words.code == 98 || words.code == 99)) return ParseStatus::INVALID;
+  if (wordsToCommand(words, cmd, variables) != TokenStatus::OK) return ParseStatus::INVALID;
+  return processCommand(cmd);
 }
 
-bool GcodeParser::parseParameters(String params, MotionCommand &cmd) {
-  cmd.has_x = cmd.has_y = cmd.has_z = cmd.has_e = cmd.has_f = cmd.has_s = false;
-  params.trim();
+static inline float *axisField(MotionCommand &cmd, int axis) {
+  switch (axis) {
+    case AXIS_X: return &cmd.x;
+    case AXIS_Y: return &cmd.y;
+    case AXIS_Z: return &cmd.z;
+    default: return &cmd.e;
+  }
+}
 
-  while (!params.isEmpty()) {
-    int next_space = params.indexOf(' ');
-    String param = (next_space == -1) ? params : params.substring(0, next_space);
-    if (param.length() < 2) {
-      DEBUG_PRINTF_AUTO("Erreur: Paramètre invalide '%s'", param.c_str());
-      return false;
+// Calcule les cibles machine absolues des axes présents dans cmd ; retourne les axes qui bougent
+uint32_t GcodeParser::resolveTargets(const MotionCommand &cmd, float target[AXIS_COUNT]) const {
+  float scale = modal.inches ? kMillimetersPerInch : 1.0f;
+  const float values[AXIS_COUNT] = {cmd.x, cmd.y, cmd.z, cmd.e};
+  uint32_t moved = 0;
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    target[axis] = modal.position[axis];
+    if (!cmd.has(kAxisParams[axis])) continue;
+    bool relative = (axis == AXIS_E) ? (modal.relative_extrusion || !modal.absolute) : !modal.absolute;
+    target[axis] = relative ? modal.position[axis] + values[axis] * scale
+                            : values[axis] * scale + modal.offset[axis];
+    if (target[axis] != modal.position[axis]) moved |= kAxisParams[axis];
+  }
+  return moved;
+}
+
+// Résout un G0/G1 en cible machine absolue. Seuls les axes qui bougent et une vitesse
+// différente de la dernière transmise restent marqués présents.
+ParseStatus GcodeParser::handleMove(MotionCommand &cmd) {
+  if (cmd.has(PARAM_F)) modal.feedrate = cmd.f * (modal.inches ? kMillimetersPerInch : 1.0f);
+
+  float target[AXIS_COUNT];
+  uint32_t moved = resolveTargets(cmd, target);
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    modal.position[axis] = target[axis];
+    *axisField(cmd, axis) = target[axis];
+  }
+  cmd.params = moved;
+  cmd.f = modal.feedrate;
+  if (!moved) return ParseStatus::CONSUMED; // Aucun déplacement : seule la vitesse modale change
+
+  if (modal.feedrate != modal.emitted_feedrate) {
+    cmd.params |= PARAM_F;
+    modal.emitted_feedrate = modal.feedrate;
+  }
+  return ParseStatus::OK;
+}
+
+// Prépare le découpage d'un G2/G3 (plan XY) et produit le premier segment dans cmd.
+// Les suivants sont obtenus par nextArcSegment, au rythme où l'appelant peut les envoyer.
+ParseStatus GcodeParser::handleArc(MotionCommand &cmd) {
+  float scale = modal.inches ? kMillimetersPerInch : 1.0f;
+  if (cmd.has(PARAM_F)) modal.feedrate = cmd.f * scale;
+  bool clockwise = (cmd.code == static_cast<int>(GcodeType::G2));
+
+  float target[AXIS_COUNT];
+  resolveTargets(cmd, target);
+  float start_x = modal.position[AXIS_X];
+  float start_y = modal.position[AXIS_Y];
+  float dx = target[AXIS_X] - start_x;
+  float dy = target[AXIS_Y] - start_y;
+  float offset_x, offset_y;
+
+  if (cmd.has(PARAM_R)) {
+    if (cmd.has(PARAM_I | PARAM_J)) {
+      DEBUG_PRINTF_AUTO("Erreur: G%d avec R et I/J à la fois", cmd.code);
+      return ParseStatus::INVALID;
     }
-    char param_type = param.charAt(0);
-    float value = param.substring(1).toFloat();
-    switch (param_type) {
-      case 'X': cmd.x = value; cmd.has_x = true; break;
-      case 'Y': cmd.y = value; cmd.has_y = true; break;
-      case 'Z': cmd.z = value; cmd.has_z = true; break;
-      case 'E': cmd.e = value; cmd.has_e = true; break;
-      case 'F': cmd.f = value / 60.0; cmd.has_f = true; break; // Convertir mm/min en mm/s
-      case 'S': cmd.s = value; cmd.has_s = true; break;
-      default:
-        DEBUG_PRINTF_AUTO("Erreur: Paramètre inconnu '%c'", param_type);
-        return false;
+    // Centre à partir du rayon (R < 0 : arc de plus de 180°)
+    float r = cmd.r * scale;
+    float chord = sqrtf(dx * dx + dy * dy);
+    float h = 4.0f * r * r - dx * dx - dy * dy;
+    if (chord == 0.0f || h < -ARC_CHORD_TOLERANCE_MM) {
+      DEBUG_PRINTF_AUTO("Erreur: G%d rayon %.3f incompatible avec la corde %.3f", cmd.code, r, chord);
+      return ParseStatus::INVALID;
     }
-    params = (next_space == -1) ? "" : params.substring(next_space + 1);
-    params.trim();
+    h = -sqrtf(h > 0.0f ? h : 0.0f) / chord;
+    if (!clockwise) h = -h;
+    if (r < 0.0f) h = -h;
+    offset_x = 0.5f * (dx - dy * h);
+    offset_y = 0.5f * (dy + dx * h);
+  } else {
+    offset_x = cmd.has(PARAM_I) ? cmd.i * scale : 0.0f;
+    offset_y = cmd.has(PARAM_J) ? cmd.j * scale : 0.0f;
   }
-  return true;
+
+  arc.center_x = start_x + offset_x;
+  arc.center_y = start_y + offset_y;
+  arc.radius = sqrtf(offset_x * offset_x + offset_y * offset_y);
+  if (arc.radius <= 0.0f) {
+    DEBUG_PRINTF_AUTO("Erreur: G%d de rayon nul", cmd.code);
+    return ParseStatus::INVALID;
+  }
+
+  // Angle parcouru ; cible confondue avec le départ = cercle complet
+  float rx = -offset_x, ry = -offset_y;
+  float tx = target[AXIS_X] - arc.center_x, ty = target[AXIS_Y] - arc.center_y;
+  float sweep = atan2f(rx * ty - ry * tx, rx * tx + ry * ty);
+  const float epsilon = 5e-7f;
+  if (clockwise) {
+    if (sweep >= -epsilon) sweep -= kTwoPi;
+  } else {
+    if (sweep <= epsilon) sweep += kTwoPi;
+  }
+  arc.start_angle = atan2f(ry, rx);
+  arc.sweep = sweep;
+
+  // Longueur de segment : tolérance de corde, allongée si le débit de segments devient trop élevé
+  float length = fabsf(sweep) * arc.radius;
+  float tolerance = ARC_CHORD_TOLERANCE_MM;
+  float segment = (tolerance < arc.radius) ? 2.0f * sqrtf(tolerance * (2.0f * arc.radius - tolerance))
+                                           : ARC_MAX_SEGMENT_MM;
+  float feed_segment = modal.feedrate / ARC_MAX_SEGMENTS_PER_SECOND;
+  if (segment < feed_segment) segment = feed_segment;
+  if (segment < ARC_MIN_SEGMENT_MM) segment = ARC_MIN_SEGMENT_MM;
+  if (segment > ARC_MAX_SEGMENT_MM) segment = ARC_MAX_SEGMENT_MM;
+  float count = ceilf(length / segment);
+  arc.segments = count < 1.0f ? 1 : (count > 65535.0f ? 65535 : static_cast<uint16_t>(count));
+  arc.current = 0;
+
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    arc.start[axis] = modal.position[axis];
+    arc.end[axis] = target[axis];
+  }
+  arc.started++;
+  arc.moved = PARAM_X | PARAM_Y;
+  if (target[AXIS_Z] != modal.position[AXIS_Z]) arc.moved |= PARAM_Z;
+  if (target[AXIS_E] != modal.position[AXIS_E]) arc.moved |= PARAM_E;
+
+  cmd.code = static_cast<int>(GcodeType::G1);
+  nextArcSegment(cmd);
+  return ParseStatus::OK;
 }
 
-bool GcodeParser::parseMovementCommand(String params, MotionCommand &cmd, GcodeType code) {
+bool GcodeParser::nextArcSegment(MotionCommand &cmd) {
+  if (arc.current >= arc.segments) return false;
+  arc.current++;
+  float target[AXIS_COUNT];
+  if (arc.current == arc.segments) {
+    for (int axis = 0; axis < AXIS_COUNT; axis++) target[axis] = arc.end[axis];
+    arc.segments = arc.current = 0;
+  } else {
+    float t = static_cast<float>(arc.current) / arc.segments;
+    float angle = arc.start_angle + arc.sweep * t;
+    target[AXIS_X] = arc.center_x + arc.radius * cosf(angle);
+    target[AXIS_Y] = arc.center_y + arc.radius * sinf(angle);
+    target[AXIS_Z] = arc.start[AXIS_Z] + (arc.end[AXIS_Z] - arc.start[AXIS_Z]) * t;
+    target[AXIS_E] = arc.start[AXIS_E] + (arc.end[AXIS_E] - arc.start[AXIS_E]) * t;
+  }
+
   cmd.type = 'G';
-  cmd.code = static_cast<int>(code);
-  if (!parseParameters(params, cmd)) return false;
-  if (!cmd.has_x && !cmd.has_y && !cmd.has_z && !cmd.has_e) {
-    DEBUG_PRINTF_AUTO("Erreur: G%d sans paramètres X, Y, Z, ou E", cmd.code);
-    return false;
+  cmd.code = static_cast<int>(GcodeType::G1);
+  cmd.params = arc.moved;
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    modal.position[axis] = target[axis];
+    *axisField(cmd, axis) = target[axis];
+  }
+  cmd.f = modal.feedrate;
+  if (modal.feedrate != modal.emitted_feedrate) {
+    cmd.params |= PARAM_F;
+    modal.emitted_feedrate = modal.feedrate;
   }
   return true;
 }
 
-bool GcodeParser::parseHomingCommand(String params, MotionCommand &cmd) {
-  cmd.type = 'G';
-  cmd.code = static_cast<int>(GcodeType::G28);
-  if (params.isEmpty()) return true; // G28 sans paramètres = homing tous axes
-  if (!parseParameters(params, cmd)) return false;
-  if (!(cmd.has_x || cmd.has_y || cmd.has_z)) {
-    DEBUG_PRINTF_AUTO("Erreur: G28 avec paramètres invalides");
-    return false;
+ParseStatus GcodeParser::handleHoming(MotionCommand &cmd) {
+  if (!cmd.has(PARAM_XYZ)) cmd.params |= PARAM_XYZ; // G28 sans paramètres = homing tous axes
+  for (int axis = AXIS_X; axis <= AXIS_Z; axis++) {
+    if (!cmd.has(kAxisParams[axis])) continue;
+    modal.position[axis] = 0.0f;
+    modal.offset[axis] = 0.0f;
+    *axisField(cmd, axis) = 0.0f;
   }
-  return true;
+  return ParseStatus::OK;
 }
 
-bool GcodeParser::parsePositioningCommand(String params, MotionCommand &cmd, GcodeType code) {
-  cmd.type = 'G';
-  cmd.code = static_cast<int>(code);
-  if (!params.isEmpty()) {
-    if (!parseParameters(params, cmd)) return false;
-    if (cmd.has_x || cmd.has_y || cmd.has_z || cmd.has_e || cmd.has_f || cmd.has_s) {
-      DEBUG_PRINTF_AUTO("Erreur: G%d ne doit pas avoir de paramètres", cmd.code);
-      return false;
+// G92 : redéfinit la position programme sans déplacement en ajustant le décalage
+ParseStatus GcodeParser::handleSetPosition(MotionCommand &cmd) {
+  float scale = modal.inches ? kMillimetersPerInch : 1.0f;
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    if (cmd.has(kAxisParams[axis])) {
+      modal.offset[axis] = modal.position[axis] - *axisField(cmd, axis) * scale;
     }
   }
-  if (code == GcodeType::G90) absolute_positioning = true;
-  if (code == GcodeType::G91) absolute_positioning = false;
-  return true;
+  return ParseStatus::OK;
 }
 
-bool GcodeParser::parseTemperatureCommand(String params, MotionCommand &cmd, GcodeType code) {
-  cmd.type = 'M';
-  cmd.code = static_cast<int>(code);
-  if (!parseParameters(params, cmd)) return false;
-  if (!cmd.has_s) {
-    DEBUG_PRINTF_AUTO("Erreur: M%d nécessite un paramètre S", cmd.code);
-    return false;
-  }
-  if (cmd.has_x || cmd.has_y || cmd.has_z || cmd.has_e || cmd.has_f) {
-    DEBUG_PRINTF_AUTO("Erreur: M%d ne doit pas avoir de paramètres X, Y, Z, E, ou F", cmd.code);
-    return false;
+// Consignes de chauffe et de ventilation, transmises telles quelles
+ParseStatus GcodeParser::handleThermal(MotionCommand &cmd) {
+  switch (cmd.code) {
+    case 104: case 109: thermal.hotend = cmd.s; break;
+    case 140: case 190: thermal.bed = cmd.s; break;
+    case 106: thermal.fan = cmd.s; break;
+    default: thermal.fan = 0.0f; break; // M107
   }
-  return true;
+  return ParseStatus::OK;
 }
 
-bool GcodeParser::parseFanCommand(String params, MotionCommand &cmd, GcodeType code) {
-  cmd.type = 'M';
-  cmd.code = static_cast<int>(code);
-  if (code == GcodeType::M106) {
-    if (!parseParameters(params, cmd)) return false;
-    if (!cmd.has_s) {
-      DEBUG_PRINTF_AUTO("Erreur: M106 nécessite un paramètre S");
-      return false;
-    }
-  } else if (code == GcodeType::M107) {
-    if (!params.isEmpty()) {
-      if (!parseParameters(params, cmd)) return false;
-      if (cmd.has_s) {
-        DEBUG_PRINTF_AUTO("Erreur: M107 ne doit pas avoir de paramètre S");
-        return false;
-      }
-    }
+#if MOTION_FIXED_POINT
+static inline int32_t toFixed(float value, float scale) {
+  float scaled = value * scale;
+  if (scaled >= 2147483647.0f) return INT32_MAX;
+  if (scaled <= -2147483648.0f) return INT32_MIN;
+  return static_cast<int32_t>(lroundf(scaled));
+}
+
+void toMotionQueueItem(const MotionCommand &cmd, MotionQueueItem &item) {
+  item.type = cmd.type;
+  item.code = static_cast<uint16_t>(cmd.code);
+  item.present = (cmd.has(PARAM_X) ? MOTION_HAS_X : 0) | (cmd.has(PARAM_Y) ? MOTION_HAS_Y : 0) |
+                 (cmd.has(PARAM_Z) ? MOTION_HAS_Z : 0) | (cmd.has(PARAM_E) ? MOTION_HAS_E : 0) |
+                 (cmd.has(PARAM_F) ? MOTION_HAS_F : 0) | (cmd.has(PARAM_S) ? MOTION_HAS_S : 0);
+  item.x = toFixed(cmd.x, 1000.0f);
+  item.y = toFixed(cmd.y, 1000.0f);
+  item.z = toFixed(cmd.z, 1000.0f);
+  item.e = toFixed(cmd.e, 1000.0f);
+  item.f = toFixed(cmd.f, 60000.0f); // mm/s -> mm/min x1000
+  item.s = toFixed(cmd.s, 1000.0f);
+}
+#else
+void toMotionQueueItem(const MotionCommand &cmd, MotionQueueItem &item) {
+  item = cmd;
+}
+#endif
+
+// Ligne reçue par parserTask : fichier (erreurs enregistrées) ou liaison série (signalées)
+static void handleQueuedLine(const LineSlab &slab) {
+  if (slab.end_of_file) {
+    gcodeParser.lock();
+    gcodeParser.flushMotion();
+    gcodeParser.summarizeErrors();
+    gcodeParser.unlock();
+    return;
   }
-  if (cmd.has_x || cmd.has_y || cmd.has_z || cmd.has_e || cmd.has_f) {
-    DEBUG_PRINTF_AUTO("Erreur: M%d ne doit pas avoir de paramètres X, Y, Z, E, ou F", cmd.code);
-    return false;
+  bool from_file = slab.line_number != 0;
+  if (from_file && parseErrors.isAborted()) return; // Fin du fichier abandonné encore en file
+
+  DEBUG_PRINTF_AUTO("Parsing ligne: '%s'", slab.text);
+  MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+  gcodeParser.lock();
+  ParseStatus status = gcodeParser.parseLine(slab.text, slab.length, cmd);
+  if (status == ParseStatus::OK) gcodeParser.emitCommand(cmd);
+  ParseErrorCode error = gcodeParser.errorCode(status);
+  uint16_t column = gcodeParser.errorColumn();
+  if (from_file && error != ParseErrorCode::NONE) gcodeParser.recordError(error, column, slab.line_number, slab.offset);
+  gcodeParser.unlock();
+  if (from_file) return;
+
+  // Ligne reçue par la liaison série : erreur signalée immédiatement
+  if (status == ParseStatus::INVALID_TYPE) {
+    DEBUG_PRINTF_AUTO("Erreur: Type de commande inconnu '%s'", slab.text);
+    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    Serial.println("ERROR: Invalid command type");
+    return;
+  }
+  if (status == ParseStatus::UNSUPPORTED) {
+    DEBUG_PRINTF_AUTO("Erreur: Code %c%d non supporté", cmd.type, cmd.code);
+    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    Serial.println("ERROR: Unsupported command");
+    return;
+  }
+
+  if (status == ParseStatus::CONSUMED) {
+    DEBUG_PRINTF_AUTO("Commande résolue par le parser: %c%d", cmd.type, cmd.code);
+  } else if (status != ParseStatus::OK) {
+    DEBUG_PRINTF_AUTO("Erreur: %s '%s' (colonne %u)", parseErrorMessage(error), slab.text, column + 1);
+    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    Serial.println("ERROR: Invalid command");
   }
-  return true;
 }
 
 void GcodeParser::parserTask(void *pvParameters) {
-  String line;
+  (void)pvParameters;
+  LineSlab *slab;
   while (1) {
-    if (xQueueReceive(gcodeQueue, &line, portMAX_DELAY) == pdTRUE) {
-      DEBUG_PRINTF_AUTO("Parsing ligne: '%s'", line.c_str());
-      MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, false, false, false, false, false, false};
-      int space_pos = line.indexOf(' ');
-      String params = (space_pos == -1) ? "" : line.substring(space_pos + 1);
-      String code_str = line.substring(0, space_pos == -1 ? line.length() : space_pos);
-
-      if (!code_str.startsWith("G") && !code_str.startsWith("M")) {
-        DEBUG_PRINTF_AUTO("Erreur: Type de commande inconnu '%s'", code_str.c_str());
-        if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-        Serial.println("ERROR: Invalid command type");
-        continue;
-      }
-
-      cmd.type = code_str.charAt(0);
-      cmd.code = code_str.substring(1).toInt();
-
-      bool valid = false;
-      switch (static_cast<GcodeType>(cmd.code)) {
-        case GcodeType::G0:
-        case GcodeType::G1:
-          valid = gcodeParser.parseMovementCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::G28:
-          valid = gcodeParser.parseHomingCommand(params, cmd);
-          break;
-        case GcodeType::G90:
-        case GcodeType::G91:
-        case GcodeType::G21:
-          valid = gcodeParser.parsePositioningCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::M104:
-        case GcodeType::M109:
-        case GcodeType::M140:
-        case GcodeType::M190:
-          valid = gcodeParser.parseTemperatureCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::M106:
-        case GcodeType::M107:
-          valid = gcodeParser.parseFanCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        default:
-          DEBUG_PRINTF_AUTO("Erreur: Code %c%d non supporté", cmd.type, cmd.code);
-          if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-          Serial.println("ERROR: Unsupported command");
-          continue;
-      }
-
-      if (valid) {
-        if (xQueueSend(motionQueue, &cmd, pdMS_TO_TICKS(5000)) != pdTRUE) {
-          DEBUG_PRINTF_AUTO("Erreur: Impossible d'envoyer à motionQueue après 5s");
-          if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-          Serial.println("ERROR: Failed to send to motionQueue");
-        } else {
-          DEBUG_PRINTF_AUTO("Commande envoyée à motionQueue: %c%d", cmd.type, cmd.code);
-        }
-      } else {
-        DEBUG_PRINTF_AUTO("Erreur: Commande invalide '%s'", line.c_str());
-        if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-        Serial.println("ERROR: Invalid command");
-      }
+    // Un mouvement retenu par l'étage de fusion est transmis dès que l'entrée se tarit
+    TickType_t wait = gcodeParser.hasPendingMotion() ? pdMS_TO_TICKS(MOTION_MERGE_IDLE_MS) : portMAX_DELAY;
+    if (xQueueReceive(gcodeQueue, &slab, wait) != pdTRUE) {
+      gcodeParser.lock();
+      gcodeParser.flushMotion();
+      gcodeParser.unlock();
+      continue;
     }
-    vTaskDelay(pdMS_TO_TICKS(10));
+    gcodeFlow.drained(gcodeQueueLevel());
+    handleQueuedLine(*slab);
+    linePool.recycle(slab);
   }
 }
@@ -1,42 +1,192 @@
-
 #pragma once
 
 #include <Arduino.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "../config.h"
+#include "gcode_tokenizer.h"
+#include "gcode_subroutine.h"
+#include "motion_merger.h"
+#include "parse_errors.h"
+#include "flow_control.h"
+#include "line_pool.h"
+
+// Représentation entière pour les consommateurs de motionQueue (MOTION_FIXED_POINT = 1).
+// Positions en µm plutôt qu'en nm : un int32 en nm limiterait la course à ±2,1 m.
+#define MOTION_HAS_X (1 << 0)
+#define MOTION_HAS_Y (1 << 1)
+#define MOTION_HAS_Z (1 << 2)
+#define MOTION_HAS_E (1 << 3)
+#define MOTION_HAS_F (1 << 4)
+#define MOTION_HAS_S (1 << 5)
 
-// Structure pour représenter une commande GCode
-struct MotionCommand {
-  char type; // 'G' ou 'M'
-  int code;  // ex. 1 pour G1, 104 pour M104
-  float x, y, z, e, f, s; // Paramètres : X, Y, Z, E, F (vitesse), S (température/vitesse ventilateur)
-  bool has_x, has_y, has_z, has_e, has_f, has_s; // Indicateurs de présence
+struct MotionCommandFixed {
+  char type;       // 'G' ou 'M'
+  uint8_t present; // MOTION_HAS_X, MOTION_HAS_Y, ...
+  uint16_t code;
+  int32_t x, y, z, e; // µm
+  int32_t f;          // mm/min x1000
+  int32_t s;          // Température / ventilateur x1000
 };
 
+#if MOTION_FIXED_POINT
+typedef MotionCommandFixed MotionQueueItem;
+#else
+typedef MotionCommand MotionQueueItem;
+#endif
+
+// Convertit la commande parsée vers le type transporté par motionQueue
+void toMotionQueueItem(const MotionCommand &cmd, MotionQueueItem &item);
+
 // Énumération des codes de commande supportés
 enum class GcodeType {
-  G0 = 0, G1 = 1, G28 = 28, G90 = 90, G91 = 91, G21 = 21,
-  M104 = 104, M109 = 109, M140 = 140, M190 = 190, M106 = 106, M107 = 107
+  G0 = 0, G1 = 1, G2 = 2, G3 = 3, G28 = 28, G90 = 90, G91 = 91, G20 = 20, G21 = 21, G92 = 92,
+  M82 = 82, M83 = 83, M104 = 104, M109 = 109, M140 = 140, M190 = 190, M106 = 106, M107 = 107
+};
+
+// Effet modal d'une commande sur l'état du parser
+enum class ModalEffect : uint8_t {
+  NONE, ABSOLUTE, RELATIVE, METRIC, INCH, ABSOLUTE_EXTRUSION, RELATIVE_EXTRUSION
+};
+
+// Résultat du parsing d'une ligne
+enum class ParseStatus : uint8_t {
+  OK,        // Commande valide à transmettre à motionQueue
+  CONSUMED,  // Commande valide entièrement résolue par le parser (modale ou sans déplacement)
+  INVALID_TYPE, UNSUPPORTED, INVALID
+};
+
+// Axes suivis par l'état modal
+enum { AXIS_X = 0, AXIS_Y, AXIS_Z, AXIS_E, AXIS_COUNT };
+
+// État modal du parser. Les positions sont en coordonnées machine (mm), si bien que
+// motionQueue ne reçoit que des cibles absolues, indépendantes de G91/G20/G92/M83.
+struct ModalState {
+  float position[AXIS_COUNT]; // Position machine courante
+  float offset[AXIS_COUNT];   // Décalage G92 : machine = programme + offset
+  float feedrate;             // Dernière vitesse programmée (mm/s)
+  float emitted_feedrate;     // Dernière vitesse transmise à motionQueue (mm/s)
+  bool absolute;              // G90 (true) ou G91 (false)
+  bool relative_extrusion;    // M83 (true) ou M82 (false)
+  bool inches;                // G20 (true) ou G21 (false)
+};
+
+// Consignes transmises par M104/M109, M140/M190 et M106/M107, rejouées par une reprise
+struct ThermalState {
+  float hotend;               // °C
+  float bed;                  // °C
+  float fan;                  // 0 à 255
+};
+
+// Arc en cours de découpage : les segments sont produits un par un à la demande
+struct ArcState {
+  float center_x, center_y, radius;
+  float start_angle, sweep;           // Radians, sweep < 0 pour G2 (horaire)
+  float start[AXIS_COUNT];            // Position machine au début de l'arc
+  float end[AXIS_COUNT];              // Cible exacte du dernier segment
+  uint32_t moved;                     // Axes modifiés par l'arc (PARAM_X, ...)
+  uint16_t segments, current;
+  uint32_t started;                   // Arcs commencés : repère la ligne qui en ouvre un
 };
 
 class GcodeParser {
+public:
+  typedef ParseStatus (GcodeParser::*CommandHandler)(MotionCommand &cmd);
+
+  // Descripteur d'une commande supportée : une ligne de la table de dispatch
+  struct CommandDescriptor {
+    char type;              // 'G' ou 'M'
+    uint16_t code;
+    uint32_t allowed;       // Paramètres acceptés
+    uint32_t required;      // Paramètres obligatoires (tous)
+    uint32_t required_any;  // Au moins un de ces paramètres (0 = aucune contrainte)
+    ModalEffect modal;
+    bool emit;              // false : commande purement modale, jamais transmise à motionQueue
+    CommandHandler handler; // Traitement spécifique après validation (peut être nullptr)
+  };
+
 private:
-  bool absolute_positioning; // G90 (true) ou G91 (false)
-  bool parseParameters(String params, MotionCommand &cmd);
-  bool parseMovementCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseHomingCommand(String params, MotionCommand &cmd);
-  bool parsePositioningCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseTemperatureCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseFanCommand(String params, MotionCommand &cmd, GcodeType code);
+  static const uint16_t DISPATCH_CODES = 256; // Codes 0..255 indexés en O(1)
+  static const uint8_t NO_DESCRIPTOR = 0xFF;
+  static const CommandDescriptor commandTable[];
+  static const size_t commandCount;
+
+  ModalState modal;
+  ThermalState thermal;
+  ArcState arc;
+  SubroutineCache subroutines;
+  uint8_t call_depth;            // Appels M98 en cours d'exécution
+  float variables[GCODE_VARIABLE_COUNT]; // #0 à #255, remis à zéro avec le programme
+  MotionMerger merger;           // Utilisé si MOTION_MERGE_SEGMENTS
+  ParseErrorCode error_code;     // Cause précise du dernier échec, NONE si seul le statut est connu
+  uint16_t error_column;
+  SemaphoreHandle_t state_mutex; // Parser partagé entre parserTask et les lecteurs SD
+  bool dry_run;                  // État modal suivi sans rien transmettre à motionQueue
+  bool program_state;            // Variables ou sous-programmes définis depuis resetProgram
+  uint32_t program_generation;   // Incrémenté par resetProgram
+  uint8_t dispatch_index[2][DISPATCH_CODES]; // [G/M][code] -> indice dans commandTable
+
+  void buildDispatchIndex();
+  const CommandDescriptor *findDescriptor(char type, int code) const;
+  void applyModalEffect(ModalEffect effect);
+  uint32_t resolveTargets(const MotionCommand &cmd, float target[AXIS_COUNT]) const;
+  ParseStatus handleMove(MotionCommand &cmd);
+  ParseStatus handleArc(MotionCommand &cmd);
+  ParseStatus handleHoming(MotionCommand &cmd);
+  ParseStatus handleSetPosition(MotionCommand &cmd);
+  ParseStatus handleThermal(MotionCommand &cmd);
+  ParseStatus callSubroutine(const TokenizedLine &words);
+  ParseStatus testWords(const TokenizedLine &words, MotionCommand &cmd);
+  bool sendMotion(const MotionCommand &cmd);
 
 public:
-  GcodeParser() : absolute_positioning(true) {}
+  GcodeParser()
+      : call_depth(0), error_code(ParseErrorCode::NONE), error_column(0), state_mutex(NULL), dry_run(false),
+        program_state(false), program_generation(0) {
+    buildDispatchIndex();
+    resetModalState();
+    memset(variables, 0, sizeof(variables));
+    memset(&thermal, 0, sizeof(thermal));
+    arc.segments = arc.current = arc.started = 0;
+  }
   void init();
+  void resetModalState();
+  void resetProgram();           // Sous-programmes et variables du fichier précédent
+  float variable(uint8_t index) const { return variables[index]; }
+  const ModalState &modalState() const { return modal; }
+  void restoreModalState(const ModalState &state);
+  const ThermalState &thermalState() const { return thermal; }
+  // Indexation et saut de lignes : les commandes mettent à jour l'état sans être émises
+  void setDryRun(bool enabled) { dry_run = enabled; }
+  // L'état du fichier ne se résume plus à ModalState : une reprise en cours de fichier
+  // perdrait les variables ou sous-programmes définis plus haut
+  bool hasProgramState() const { return program_state; }
+  bool nextArcSegment(MotionCommand &cmd);
+  const ArcState &arcState() const { return arc; } // Dernier arc, même achevé
+  ParseStatus parseLine(const char *line, size_t len, MotionCommand &cmd);
+  ParseStatus processWords(const TokenizedLine &words, MotionCommand &cmd);
+  ParseStatus processCommand(MotionCommand &cmd);
+  bool emitCommand(MotionCommand &cmd);
+  bool flushMotion();            // Transmet le mouvement retenu par l'étage de fusion
+  void discardMotion() { merger.reset(); } // L'abandonne (fichier abandonné, nouveau départ)
+  bool hasPendingMotion() const { return merger.hasPending(); }
+  ParseErrorCode errorCode(ParseStatus status) const;
+  uint16_t errorColumn() const { return error_column; }
+  bool recordError(ParseErrorCode code, uint16_t column, uint32_t line, uint32_t offset);
+  void summarizeErrors();
+  bool lock(TickType_t ticks_to_wait = portMAX_DELAY);
+  void unlock();
   void testParse(String cmd);
   static void parserTask(void *pvParameters);
 };
 
+// Envoi d'un slab vers gcodeQueue, régulé par seuils (GCODE_QUEUE_HIGH/LOW_WATERMARK) ;
+// ticks_to_wait borne l'attente sans progrès de parserTask. En cas d'échec, le slab
+// reste à l'appelant.
+bool sendGcodeLine(LineSlab *slab, TickType_t ticks_to_wait);
+void clearGcodeQueue();         // Rend au pool les lignes en attente
+
 extern GcodeParser gcodeParser;
 extern QueueHandle_t gcodeQueue;
-extern QueueHandle_t motionQueue;
 extern SemaphoreHandle_t errorSemaphore;
@@ -0,0 +1,63 @@
+#include "gcode_preparse.h"
+#include <string.h>
+
+size_t preparseLines(const char *text, size_t len, bool final,
+                     uint32_t &line_number, uint32_t &offset, PreparsedChunk &chunk) {
+  size_t pos = 0;
+  while (pos < len && chunk.count < PREPARSE_CHUNK_LINES) {
+    const char *start = text + pos;
+    const char *newline = static_cast<const char *>(memchr(start, '\n', len - pos));
+    if (!newline && !final) break;
+    size_t line_len = newline ? newline - start : len - pos;
+    size_t used = newline ? line_len + 1 : line_len;
+    line_number++;
+
+    PreparsedLine &out = chunk.lines[chunk.count];
+    size_t column;
+    out.status = tokenizeWords(start, line_len, out.words, column);
+    if (out.status != TokenStatus::EMPTY) {
+      out.line = line_number;
+      out.offset = offset;
+      out.column = static_cast<uint16_t>(column);
+      chunk.count++;
+    }
+    pos += used;
+    offset += used;
+  }
+  return pos;
+}
+
+void PreparseBuffer::attach(PreparsedChunk *storage, uint8_t count) {
+  slots = storage;
+  slot_count = count < PREPARSE_SLOTS ? count : PREPARSE_SLOTS;
+  reset();
+}
+
+void PreparseBuffer::reset() {
+  for (uint8_t n = 0; n < PREPARSE_SLOTS; n++) ready[n].store(0, std::memory_order_relaxed);
+  released.store(0, std::memory_order_release);
+}
+
+PreparsedChunk *PreparseBuffer::acquire(uint32_t sequence) {
+  if (!slot_count || sequence - released.load(std::memory_order_acquire) >= slot_count) return NULL;
+  PreparsedChunk *chunk = &slots[sequence % slot_count];
+  chunk->sequence = sequence;
+  chunk->count = 0;
+  chunk->last = false;
+  return chunk;
+}
+
+void PreparseBuffer::publish(PreparsedChunk *chunk) {
+  ready[chunk->sequence % slot_count].store(chunk->sequence + 1, std::memory_order_release);
+}
+
+PreparsedChunk *PreparseBuffer::peek(uint32_t sequence) {
+  if (!slot_count) return NULL;
+  uint8_t slot = sequence % slot_count;
+  if (ready[slot].load(std::memory_order_acquire) != sequence + 1) return NULL;
+  return &slots[slot];
+}
+
+void PreparseBuffer::release(uint32_t sequence) {
+  released.store(sequence + 1, std::memory_order_release);
+}
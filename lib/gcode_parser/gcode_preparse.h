@@ -0,0 +1,56 @@
+#pragma once
+
+// Pré-découpage parallèle d'un fichier G-code : un producteur (cœur 0) découpe le texte
+// en blocs de lignes tokenisées, le consommateur (cœur 1) les reprend dans l'ordre des
+// numéros de séquence pour la passe séquentielle (état modal, variables, sous-programmes).
+// Sans dépendance Arduino ni FreeRTOS : l'attente est laissée à l'appelant.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "../config.h"
+#include "gcode_tokenizer.h"
+
+// Ligne tokenisée, avec sa position dans le fichier pour le journal d'erreurs
+struct PreparsedLine {
+  uint32_t line;       // Ligne du fichier, à partir de 1
+  uint32_t offset;     // Octet de début de la ligne
+  uint16_t column;     // Position de l'erreur si status != OK
+  TokenStatus status;  // Jamais EMPTY : les lignes vides ne sont pas conservées
+  TokenizedLine words;
+};
+
+struct PreparsedChunk {
+  uint32_t sequence;
+  uint16_t count;
+  bool last;           // Dernier bloc du fichier
+  PreparsedLine lines[PREPARSE_CHUNK_LINES];
+};
+
+// Découpe et tokenize les lignes complètes de text[0, len) jusqu'à remplir chunk
+// (chunk.count n'est pas remis à zéro). Une fin sans '\n' n'est prise que si final est
+// vrai. line_number et offset suivent la position dans le fichier. Retourne les octets
+// consommés.
+size_t preparseLines(const char *text, size_t len, bool final,
+                     uint32_t &line_number, uint32_t &offset, PreparsedChunk &chunk);
+
+// Tampon de blocs indexé par numéro de séquence : le bloc n occupe slots[n % count] et
+// n'est visible du consommateur qu'une fois publié, quel que soit l'ordre de production.
+class PreparseBuffer {
+private:
+  PreparsedChunk *slots;
+  uint8_t slot_count;
+  std::atomic<uint32_t> ready[PREPARSE_SLOTS]; // Séquence + 1 du bloc publié dans chaque slot
+  std::atomic<uint32_t> released;              // Premier bloc non encore rendu par le consommateur
+
+public:
+  PreparseBuffer() : slots(NULL), slot_count(0), released(0) {}
+  void attach(PreparsedChunk *storage, uint8_t count); // count <= PREPARSE_SLOTS
+  void reset();                                          // Début de fichier, sans producteur actif
+  // Producteur : slot du bloc sequence, NULL tant que le consommateur ne l'a pas libéré
+  PreparsedChunk *acquire(uint32_t sequence);
+  void publish(PreparsedChunk *chunk);
+  // Consommateur : bloc sequence s'il est publié, NULL sinon
+  PreparsedChunk *peek(uint32_t sequence);
+  void release(uint32_t sequence);
+};
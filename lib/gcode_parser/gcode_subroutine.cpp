@@ -0,0 +1,77 @@
+#include "gcode_subroutine.h"
+#include <esp_heap_caps.h>
+
+void SubroutineCache::release(Subroutine &sub) {
+  if (sub.records) heap_caps_free(sub.records);
+  used_bytes -= sub.capacity;
+  sub.records = NULL;
+  sub.size = sub.capacity = 0;
+  sub.commands = 0;
+}
+
+bool SubroutineCache::begin(uint32_t number) {
+  if (recording >= 0) return false; // Définitions imbriquées interdites
+  int index = -1;
+  for (uint8_t n = 0; n < count; n++) {
+    if (subs[n].number == number) index = n;
+  }
+  if (index < 0) {
+    if (count == SUBROUTINE_MAX) return false;
+    index = count++;
+    subs[index].records = NULL;
+    subs[index].capacity = 0;
+  }
+  release(subs[index]);
+  subs[index].number = number;
+  record_state.reset();
+  recording = index;
+  return true;
+}
+
+bool SubroutineCache::append(const TokenizedLine &line) {
+  if (recording < 0) return false;
+  Subroutine &sub = subs[recording];
+  if (sub.capacity - sub.size < GCODE_BINARY_MAX_RECORD) {
+    size_t grow = sub.capacity ? sub.capacity : 1024;
+    if (used_bytes + grow > SUBROUTINE_CACHE_BYTES) grow = SUBROUTINE_CACHE_BYTES - used_bytes;
+    if (grow < GCODE_BINARY_MAX_RECORD) return false;
+    // PSRAM en priorité : un corps de couche peut atteindre plusieurs centaines de Ko
+    uint8_t *records = static_cast<uint8_t *>(
+        heap_caps_realloc(sub.records, sub.capacity + grow, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (!records) records = static_cast<uint8_t *>(heap_caps_realloc(sub.records, sub.capacity + grow, MALLOC_CAP_8BIT));
+    if (!records) return false;
+    sub.records = records;
+    sub.capacity += grow;
+    used_bytes += grow;
+  }
+  size_t size = encodeGcodeRecord(line, record_state, sub.records + sub.size);
+  if (size == 0) return false;
+  sub.size += size;
+  sub.commands++;
+  return true;
+}
+
+void SubroutineCache::end() {
+  recording = -1;
+}
+
+void SubroutineCache::abort() {
+  if (recording < 0) return;
+  // Sous-programme incomplet : retiré en le remplaçant par le dernier de la table
+  release(subs[recording]);
+  subs[recording] = subs[--count];
+  recording = -1;
+}
+
+const Subroutine *SubroutineCache::find(uint32_t number) const {
+  for (uint8_t n = 0; n < count; n++) {
+    if (n != recording && subs[n].number == number) return &subs[n];
+  }
+  return NULL;
+}
+
+void SubroutineCache::clear() {
+  for (uint8_t n = 0; n < count; n++) release(subs[n]);
+  count = 0;
+  recording = -1;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../config.h"
+#include "gcode_binary.h"
+
+// Corps d'un sous-programme O<n> ... M99, stocké sous forme d'enregistrements
+// gcode_binary : découpé une seule fois, rejoué à chaque M98 sans relire la SD
+struct Subroutine {
+  uint32_t number;
+  uint32_t commands;
+  size_t size;
+  size_t capacity;
+  uint8_t *records;
+};
+
+class SubroutineCache {
+private:
+  Subroutine subs[SUBROUTINE_MAX];
+  uint8_t count;
+  int8_t recording;            // Indice du sous-programme en cours de définition, -1 sinon
+  GcodeBinaryState record_state;
+  size_t used_bytes;           // Capacité allouée, bornée par SUBROUTINE_CACHE_BYTES
+
+  void release(Subroutine &sub);
+
+public:
+  SubroutineCache() : count(0), recording(-1), used_bytes(0) {}
+  bool begin(uint32_t number);  // Une redéfinition remplace l'ancien corps
+  bool append(const TokenizedLine &line);
+  void end();
+  void abort();                 // Abandonne la définition en cours
+  bool isRecording() const { return recording >= 0; }
+  const Subroutine *find(uint32_t number) const;
+  void clear();
+};
@@ -0,0 +1,239 @@
+#include "gcode_tokenizer.h"
+#include <string.h>
+
+static const int kMaxCommandCode = 99999;        // G, M et O au-delà : ligne rejetée
+static const long kMaxLineNumber = 2147483647L;  // N sur 32 bits, comme Marlin
+
+static inline bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline char toUpper(char c) {
+  return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+// Saute blancs et commentaires "(...)" ; un ';' termine la ligne (end est alors ramené dessus).
+// Retourne false si un commentaire entre parenthèses n'est pas fermé.
+static bool skipFiller(const char *&p, const char *&end) {
+  while (p < end) {
+    if (isBlank(*p)) {
+      p++;
+    } else if (*p == ';') {
+      end = p;
+    } else if (*p == '(') {
+      const char *close = static_cast<const char *>(memchr(p, ')', end - p));
+      if (!close) return false;
+      p = close + 1;
+    } else {
+      break;
+    }
+  }
+  return true;
+}
+
+LineCheck checkNumberedLine(const char *line, size_t len, NumberedLine &out) {
+  const char *p = line;
+  const char *end = line + len;
+  out.has_line_number = out.has_checksum = false;
+  out.line_number = 0;
+  while (p < end && isBlank(*p)) p++;
+
+  const char *comment = static_cast<const char *>(memchr(p, ';', end - p));
+  const char *body_end = comment ? comment : end;
+  while (body_end > p && isBlank(body_end[-1])) body_end--;
+  const char *star = body_end;
+  while (star > p && *(star - 1) >= '0' && *(star - 1) <= '9') star--;
+
+  // Comme Marlin, "*<chiffres>" n'est une somme de contrôle qu'après un N : sans
+  // numéro, "#1 = #2 * 3" reste une affectation
+  LineCheck status = LineCheck::OK;
+  bool numbered = p < body_end && toUpper(*p) == 'N';
+  if (numbered && star > p && star < body_end && *(star - 1) == '*') {
+    if (body_end - star > 3) return LineCheck::MALFORMED;
+    unsigned expected = 0;
+    for (const char *q = star; q < body_end; q++) expected = expected * 10 + (*q - '0');
+    uint8_t checksum = 0;
+    for (const char *q = p; q < star - 1; q++) checksum ^= static_cast<uint8_t>(*q);
+    out.has_checksum = true;
+    if (expected != checksum) status = LineCheck::BAD_CHECKSUM;
+    body_end = star - 1;
+  }
+
+  if (numbered) {
+    const char *q = p + 1;
+    bool negative = (q < body_end && *q == '-');
+    if (negative) q++;
+    if (q == body_end || *q < '0' || *q > '9') return LineCheck::MALFORMED;
+    long number = 0;
+    while (q < body_end && *q >= '0' && *q <= '9') {
+      number = number * 10 + (*q++ - '0');
+      if (number > kMaxLineNumber) return LineCheck::MALFORMED;
+    }
+    out.has_line_number = true;
+    out.line_number = negative ? -number : number;
+    p = q;
+  }
+  out.body = p;
+  out.body_len = body_end - p;
+  return status;
+}
+
+TokenStatus tokenizeWords(const char *line, size_t len, TokenizedLine &out, size_t &column) {
+  column = 0;
+  out.count = 0;
+  out.condition = out.value = GCODE_NO_EXPRESSION;
+  out.code_size = 0;
+  NumberedLine numbered;
+  switch (checkNumberedLine(line, len, numbered)) {
+    case LineCheck::MALFORMED: return TokenStatus::BAD_LINE_NUMBER;
+    case LineCheck::BAD_CHECKSUM: return TokenStatus::BAD_CHECKSUM;
+    case LineCheck::OK: break;
+  }
+  const char *p = numbered.body;
+  const char *end = numbered.body + numbered.body_len;
+
+  if (!skipFiller(p, end)) {
+    column = p - line;
+    return TokenStatus::UNTERMINATED_COMMENT;
+  }
+  if (p == end) return TokenStatus::EMPTY;
+
+  // Préfixe conditionnel : "IF [#1 GT 2] G1 X10" n'exécute la suite que si la condition est vraie
+  column = p - line;
+  if (end - p > 2 && toUpper(p[0]) == 'I' && toUpper(p[1]) == 'F') {
+    const char *q = p + 2;
+    while (q < end && isBlank(*q)) q++;
+    if (q < end && *q == '[') {
+      out.condition = out.code_size;
+      if (!compileGcodeExpression(q, end, out.bytecode, out.code_size, GCODE_LINE_BYTECODE, false)) {
+        return TokenStatus::BAD_EXPRESSION;
+      }
+      p = q;
+      if (!skipFiller(p, end)) {
+        column = p - line;
+        return TokenStatus::UNTERMINATED_COMMENT;
+      }
+      column = p - line;
+    }
+  }
+
+  // Affectation : "#3 = [#3 + 0.2]" ou "#3 = #3 + 0.2"
+  if (p < end && *p == '#') {
+    p++;
+    if (p == end || *p < '0' || *p > '9') return TokenStatus::BAD_EXPRESSION;
+    int index = 0;
+    while (p < end && *p >= '0' && *p <= '9' && index < GCODE_VARIABLE_COUNT) index = index * 10 + (*p++ - '0');
+    while (p < end && isBlank(*p)) p++;
+    if (index >= GCODE_VARIABLE_COUNT || p == end || *p != '=') return TokenStatus::BAD_EXPRESSION;
+    p++;
+    out.type = '#';
+    out.code = index;
+    out.value = out.code_size;
+    if (!compileGcodeExpression(p, end, out.bytecode, out.code_size, GCODE_LINE_BYTECODE, true) ||
+        !skipFiller(p, end) || p != end) {
+      column = p - line;
+      return TokenStatus::BAD_EXPRESSION;
+    }
+    return TokenStatus::OK;
+  }
+
+  // Mot de commande : "G1", "g1", "M104", "O100"... éventuellement collé aux paramètres
+  char type = toUpper(*p++);
+  if ((type != 'G' && type != 'M' && type != 'O') || p == end || *p < '0' || *p > '9') return TokenStatus::BAD_COMMAND;
+  int code = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    code = code * 10 + (*p++ - '0');
+    if (code > kMaxCommandCode) return TokenStatus::BAD_COMMAND;
+  }
+  if (p < end && *p == '.') return TokenStatus::BAD_COMMAND; // Sous-codes (G38.2...) non supportés
+  out.type = type;
+  out.code = code;
+
+  // Paramètres : délimités par les lettres, avec ou sans espaces ("X10 Y5" ou "X10Y5")
+  while (true) {
+    if (!skipFiller(p, end)) {
+      column = p - line;
+      return TokenStatus::UNTERMINATED_COMMENT;
+    }
+    if (p == end) break;
+    column = p - line;
+    char letter = toUpper(*p);
+    if (letter < 'A' || letter > 'Z') return TokenStatus::BAD_LETTER;
+    if (out.count == GCODE_MAX_WORDS) return TokenStatus::TOO_MANY_WORDS;
+    p++;
+    GcodeWord &word = out.words[out.count];
+    word.expression = GCODE_NO_EXPRESSION;
+    const char *value = p;
+    if (value < end && *value == '-') value++;
+    if (value < end && (*value == '#' || *value == '[')) {
+      word.expression = out.code_size;
+      word.value.mantissa = 0;
+      word.value.decimals = 0;
+      if (!compileGcodeExpression(p, end, out.bytecode, out.code_size, GCODE_LINE_BYTECODE, false)) {
+        return TokenStatus::BAD_EXPRESSION;
+      }
+    } else if (!scanGcodeDecimal(p, end, word.value)) {
+      return TokenStatus::BAD_VALUE;
+    }
+    word.letter = letter;
+    out.count++;
+  }
+  return TokenStatus::OK;
+}
+
+bool wordValue(const TokenizedLine &words, const GcodeWord &word, const float *variables, float &value) {
+  if (word.expression == GCODE_NO_EXPRESSION) {
+    value = gcodeDecimalToFloat(word.value);
+    return true;
+  }
+  return variables && evaluateGcodeExpression(words.bytecode + word.expression, variables, value);
+}
+
+TokenStatus wordsToCommand(const TokenizedLine &words, MotionCommand &cmd, const float *variables) {
+  cmd.type = words.type;
+  cmd.code = words.code;
+  cmd.params = 0;
+  for (uint8_t n = 0; n < words.count; n++) {
+    const GcodeWord &word = words.words[n];
+    float value;
+    if (!wordValue(words, word, variables, value)) return TokenStatus::BAD_EXPRESSION;
+    switch (word.letter) {
+      case 'X': cmd.x = value; break;
+      case 'Y': cmd.y = value; break;
+      case 'Z': cmd.z = value; break;
+      case 'E': cmd.e = value; break;
+      case 'F': cmd.f = value / 60.0f; break; // Convertir mm/min en mm/s
+      case 'S': cmd.s = value; break;
+      case 'I': cmd.i = value; break;
+      case 'J': cmd.j = value; break;
+      case 'R': cmd.r = value; break;
+      default: return TokenStatus::UNKNOWN_PARAMETER;
+    }
+    cmd.params |= PARAM_BIT(word.letter);
+  }
+  return TokenStatus::OK;
+}
+
+TokenStatus tokenizeLine(const char *line, size_t len, MotionCommand &cmd, size_t &column) {
+  TokenizedLine words;
+  TokenStatus status = tokenizeWords(line, len, words, column);
+  if (status != TokenStatus::OK) return status;
+  return wordsToCommand(words, cmd);
+}
+
+const char *tokenStatusMessage(TokenStatus status) {
+  switch (status) {
+    case TokenStatus::OK: return "OK";
+    case TokenStatus::EMPTY: return "Ligne vide";
+    case TokenStatus::BAD_LINE_NUMBER: return "Numéro de ligne ou checksum mal formé";
+    case TokenStatus::BAD_CHECKSUM: return "Checksum invalide";
+    case TokenStatus::UNTERMINATED_COMMENT: return "Commentaire non fermé";
+    case TokenStatus::BAD_COMMAND: return "Type de commande inconnu";
+    case TokenStatus::BAD_LETTER: return "Paramètre invalide";
+    case TokenStatus::BAD_VALUE: return "Valeur invalide";
+    case TokenStatus::TOO_MANY_WORDS: return "Trop de paramètres";
+    case TokenStatus::UNKNOWN_PARAMETER: return "Paramètre inconnu";
+    case TokenStatus::BAD_EXPRESSION: return "Expression invalide";
+  }
+  return "?";
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+// Tokenizer G-code sans dépendance Arduino ni FreeRTOS : partagé par le firmware
+// et les outils hôte (tools/gcode2bin)
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gcode_number.h"
+#include "gcode_expression.h"
+
+// Masque de présence des paramètres : un bit par lettre (bit 0 = 'A', bit 25 = 'Z')
+#define PARAM_BIT(letter) (1UL << ((letter) - 'A'))
+#define PARAM_X PARAM_BIT('X')
+#define PARAM_Y PARAM_BIT('Y')
+#define PARAM_Z PARAM_BIT('Z')
+#define PARAM_E PARAM_BIT('E')
+#define PARAM_F PARAM_BIT('F')
+#define PARAM_S PARAM_BIT('S')
+#define PARAM_I PARAM_BIT('I')
+#define PARAM_J PARAM_BIT('J')
+#define PARAM_R PARAM_BIT('R')
+#define PARAM_XYZ (PARAM_X | PARAM_Y | PARAM_Z)
+#define PARAM_XYZE (PARAM_XYZ | PARAM_E)
+
+// Structure pour représenter une commande GCode
+struct MotionCommand {
+  char type; // 'G' ou 'M'
+  int code;  // ex. 1 pour G1, 104 pour M104
+  float x, y, z, e, f, s; // Paramètres : X, Y, Z, E, F (vitesse), S (température/vitesse ventilateur)
+  uint32_t params; // Indicateurs de présence (PARAM_X, PARAM_Y, ...)
+  float i, j, r;   // Arcs G2/G3 : centre relatif ou rayon (jamais transmis à motionQueue)
+
+  bool has(uint32_t param_bits) const { return (params & param_bits) != 0; }
+};
+
+// Mot G-code brut : lettre et valeur décimale exacte, ou expression compilée
+struct GcodeWord {
+  char letter;
+  uint8_t expression;  // Offset dans TokenizedLine::bytecode, GCODE_NO_EXPRESSION si littéral
+  GcodeDecimal value;
+};
+
+#define GCODE_MAX_WORDS 12
+#define GCODE_LINE_BYTECODE 96 // Bytecode de toutes les expressions d'une ligne
+
+// Ligne découpée en mots, avant conversion en MotionCommand
+struct TokenizedLine {
+  char type;           // 'G', 'M', 'O' (début de sous-programme) ou '#' (affectation #code = ...)
+  int code;
+  uint8_t count;
+  uint8_t condition;   // Préfixe IF [...] : offset de l'expression, GCODE_NO_EXPRESSION sinon
+  uint8_t value;       // Affectation : offset de l'expression affectée
+  uint8_t code_size;
+  GcodeWord words[GCODE_MAX_WORDS];
+  uint8_t bytecode[GCODE_LINE_BYTECODE];
+};
+
+// Résultat du découpage d'une ligne
+enum class TokenStatus : uint8_t {
+  OK,
+  EMPTY,                // Ligne vide ou commentaire seul
+  BAD_LINE_NUMBER,      // Préfixe N ou suffixe * mal formé
+  BAD_CHECKSUM,
+  UNTERMINATED_COMMENT,
+  BAD_COMMAND,          // Mot de commande absent ou autre que G/M/O
+  BAD_LETTER,
+  BAD_VALUE,
+  TOO_MANY_WORDS,
+  UNKNOWN_PARAMETER,    // Lettre sans champ dans MotionCommand
+  BAD_EXPRESSION        // Expression invalide, trop longue ou non évaluable
+};
+
+// Résultat de la vérification "N<ligne> ... *<checksum>"
+enum class LineCheck : uint8_t {
+  OK, BAD_CHECKSUM, MALFORMED
+};
+
+// Ligne numérotée découpée sans copie : body désigne la commande sans N ni checksum
+struct NumberedLine {
+  bool has_line_number;
+  bool has_checksum;
+  long line_number;
+  const char *body;
+  size_t body_len;
+};
+
+// Vérifie le préfixe N<ligne> et le suffixe *<checksum> (XOR des octets précédant '*').
+// Le suffixe n'est cherché qu'après un N ; l'exigence de sa présence revient à l'appelant.
+LineCheck checkNumberedLine(const char *line, size_t len, NumberedLine &out);
+
+// Découpe une ligne en mots en une passe, sans allocation. Accepte les mots collés
+// ("G1X10Y5") ou séparés, en majuscules ou minuscules, avec commentaires "(...)" et ';'.
+// Les valeurs "#n" et "[expression]", les affectations "#n = expression" et le préfixe
+// "IF [condition]" sont compilés en bytecode (gcode_expression.h). Sur une ligne numérotée,
+// un membre droit finissant par "*<chiffres>" est lu comme checksum : le mettre entre crochets.
+// column reçoit la position de l'erreur éventuelle.
+TokenStatus tokenizeWords(const char *line, size_t len, TokenizedLine &out, size_t &column);
+
+// Valeur d'un mot : littéral exact ou expression évaluée avec variables (NULL : refusée)
+bool wordValue(const TokenizedLine &words, const GcodeWord &word, const float *variables, float &value);
+
+// Convertit les mots en MotionCommand (F converti de mm/min en mm/s)
+TokenStatus wordsToCommand(const TokenizedLine &words, MotionCommand &cmd, const float *variables = NULL);
+
+// tokenizeWords puis wordsToCommand
+TokenStatus tokenizeLine(const char *line, size_t len, MotionCommand &cmd, size_t &column);
+
+const char *tokenStatusMessage(TokenStatus status);
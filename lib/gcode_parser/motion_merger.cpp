@@ -0,0 +1,123 @@
+#include "motion_merger.h"
+#include <math.h>
+#include <string.h>
+
+static const float kMaxAngleCos = cosf(MOTION_MERGE_MAX_ANGLE_DEG * 0.0174532925f);
+
+static inline bool isLinearMove(const MotionCommand &cmd) {
+  return cmd.type == 'G' && (cmd.code == 0 || cmd.code == 1);
+}
+
+void MotionMerger::reset() {
+  if (has_pending) memcpy(position, start, sizeof(position));
+  has_pending = false;
+  last_dx = last_dy = last_length = run_length = run_extrusion = 0.0f;
+  joint_count = 0;
+}
+
+// Suit la position machine à partir des commandes transmises : les mouvements portent
+// toujours les quatre axes, G28 remet à zéro les axes référencés
+void MotionMerger::track(const MotionCommand &cmd) {
+  if (cmd.type != 'G') return;
+  if (cmd.code <= 3) {
+    position[0] = cmd.x;
+    position[1] = cmd.y;
+    position[2] = cmd.z;
+    position[3] = cmd.e;
+  } else if (cmd.code == 28) {
+    if (cmd.has(PARAM_X)) position[0] = 0.0f;
+    if (cmd.has(PARAM_Y)) position[1] = 0.0f;
+    if (cmd.has(PARAM_Z)) position[2] = 0.0f;
+  }
+}
+
+void MotionMerger::startRun(const MotionCommand &cmd) {
+  memcpy(start, position, sizeof(start));
+  pending = cmd;
+  has_pending = true;
+  last_dx = cmd.x - start[0];
+  last_dy = cmd.y - start[1];
+  last_length = run_length = sqrtf(last_dx * last_dx + last_dy * last_dy);
+  run_extrusion = cmd.e - start[3];
+  joint_count = 0;
+  track(cmd);
+}
+
+bool MotionMerger::canMerge(const MotionCommand &cmd, float dx, float dy, float length, float de) const {
+  // Z et la vitesse doivent être inchangés, le mouvement en attente rester dans le plan XY
+  if (cmd.code != pending.code || cmd.f != pending.f || cmd.z != position[2] || pending.z != start[2]) return false;
+  if (length == 0.0f || joint_count == MOTION_MERGE_MAX_SEGMENTS) return false; // Rétraction seule : jamais fusionnée
+
+  // Même ratio d'extrusion (déplacements sans extrusion entre eux)
+  float expected = run_extrusion * length;
+  float actual = de * run_length;
+  if (fabsf(actual - expected) > MOTION_MERGE_EXTRUSION_TOLERANCE * fabsf(expected)) return false;
+
+  // Segment plus court qu'un pas : absorbé quelle que soit sa direction
+  if (length < MOTION_MIN_SEGMENT_MM) return true;
+  if (last_length >= MOTION_MIN_SEGMENT_MM &&
+      (dx * last_dx + dy * last_dy) < kMaxAngleCos * length * last_length) return false;
+
+  // Toutes les jonctions absorbées, y compris la position actuelle, restent près de la corde
+  float chord_x = cmd.x - start[0];
+  float chord_y = cmd.y - start[1];
+  float chord = sqrtf(chord_x * chord_x + chord_y * chord_y);
+  float limit = MOTION_MERGE_MAX_DEVIATION_MM * chord;
+  for (uint8_t n = 0; n <= joint_count; n++) {
+    float px = (n < joint_count ? joints[n][0] : position[0]) - start[0];
+    float py = (n < joint_count ? joints[n][1] : position[1]) - start[1];
+    if (fabsf(px * chord_y - py * chord_x) > limit) return false;
+  }
+  return true;
+}
+
+uint8_t MotionMerger::push(const MotionCommand &cmd, MotionCommand ready[2]) {
+  uint8_t count = 0;
+  if (!isLinearMove(cmd)) {
+    if (has_pending) ready[count++] = pending;
+    has_pending = false;
+    ready[count++] = cmd;
+    track(cmd);
+    return count;
+  }
+
+  float dx = cmd.x - position[0];
+  float dy = cmd.y - position[1];
+  float length = sqrtf(dx * dx + dy * dy);
+  float de = cmd.e - position[3];
+  if (length < MOTION_MIN_SEGMENT_MM && de == 0.0f && cmd.z == position[2] && !cmd.has(PARAM_F)) {
+    dropped++; // Position non suivie : le prochain écart reste mesuré depuis la dernière transmise
+    return 0;
+  }
+  if (has_pending) {
+    if (canMerge(cmd, dx, dy, length, de)) {
+      // Cibles absolues : la commande fusionnée reprend celles du dernier segment
+      uint32_t params = pending.params | cmd.params;
+      joints[joint_count][0] = position[0];
+      joints[joint_count][1] = position[1];
+      joint_count++;
+      pending = cmd;
+      pending.params = params;
+      run_length += length;
+      run_extrusion += de;
+      if (length >= MOTION_MIN_SEGMENT_MM) {
+        last_dx = dx;
+        last_dy = dy;
+        last_length = length;
+      }
+      track(cmd);
+      merged++;
+      return 0;
+    }
+    ready[count++] = pending;
+  }
+  startRun(cmd);
+  return count;
+}
+
+bool MotionMerger::flush(MotionCommand &out) {
+  if (!has_pending) return false;
+  out = pending;
+  has_pending = false;
+  return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "../config.h"
+#include "gcode_tokenizer.h"
+
+// Étage de fusion entre le parser et motionQueue : les G0/G1 consécutifs dans le plan XY,
+// de même vitesse et de même ratio d'extrusion, dont la direction change peu à chaque
+// jonction et dont les jonctions restent proches de la corde résultante, sont réunis en
+// un seul mouvement. Les cibles étant absolues, la fusion ne change que le chemin
+// intermédiaire, jamais la position ni l'extrusion finales.
+//
+// Un déplacement XY de moins d'un pas (MOTION_MIN_SEGMENT_MM) sans changement de Z, d'E
+// ni de vitesse est abandonné : mesuré depuis la dernière position transmise, l'écart
+// ainsi laissé ne dépasse jamais un pas et la cible absolue suivante le rattrape. Un
+// segment aussi court mais qui extrude reste soumis aux contrôles de fusion, pour ne pas
+// perdre de filament.
+class MotionMerger {
+private:
+  MotionCommand pending;
+  bool has_pending;
+  float start[4];     // Position au début du mouvement en attente (X, Y, Z, E)
+  float position[4];  // Dernière position transmise ou en attente
+  float last_dx, last_dy, last_length; // Dernier segment non négligeable
+  float run_length, run_extrusion;
+  float joints[MOTION_MERGE_MAX_SEGMENTS][2]; // Jonctions XY absorbées
+  uint8_t joint_count;
+  uint32_t merged;
+  uint32_t dropped;
+
+  void startRun(const MotionCommand &cmd);
+  bool canMerge(const MotionCommand &cmd, float dx, float dy, float length, float de) const;
+  void track(const MotionCommand &cmd);
+
+public:
+  MotionMerger() : has_pending(false), merged(0), dropped(0) {
+    memset(start, 0, sizeof(start));
+    memset(position, 0, sizeof(position));
+    reset();
+  }
+  // Abandonne le mouvement en attente (fichier terminé, abandonné ou repris ailleurs) ;
+  // la position suivie revient à la dernière transmise
+  void reset();
+  // Place dans ready les commandes à transmettre maintenant (0 à 2), dans l'ordre
+  uint8_t push(const MotionCommand &cmd, MotionCommand ready[2]);
+  // Récupère le mouvement en attente (file d'entrée vide, fin de fichier)
+  bool flush(MotionCommand &out);
+  bool hasPending() const { return has_pending; }
+  uint32_t mergedCount() const { return merged; }
+  uint32_t droppedCount() const { return dropped; }
+};
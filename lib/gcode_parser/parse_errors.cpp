@@ -0,0 +1,42 @@
+#include "parse_errors.h"
+#include <string.h>
+
+ParseErrorLog parseErrors;
+
+void ParseErrorLog::reset() {
+  memset(&first_error, 0, sizeof(first_error));
+  next = stored = 0;
+  total = 0;
+  aborted = false;
+}
+
+bool ParseErrorLog::report(ParseErrorCode code, uint32_t line, uint32_t offset, uint16_t column) {
+  ParseErrorRecord record = {offset, line, column, code, 0};
+  if (total == 0) first_error = record;
+  if (total < UINT32_MAX) total++;
+  if (policy != ParseErrorPolicy::COUNT) {
+    ring[next] = record;
+    next = (next + 1) % PARSE_ERROR_RING_SIZE;
+    if (stored < PARSE_ERROR_RING_SIZE) stored++;
+  }
+  if (policy == ParseErrorPolicy::ABORT) aborted = true;
+  return !aborted;
+}
+
+uint8_t ParseErrorLog::recent(ParseErrorRecord *out, uint8_t max) const {
+  uint8_t count = stored < max ? stored : max;
+  for (uint8_t n = 0; n < count; n++) {
+    out[n] = ring[(next + PARSE_ERROR_RING_SIZE - count + n) % PARSE_ERROR_RING_SIZE];
+  }
+  return count;
+}
+
+const char *parseErrorMessage(ParseErrorCode code) {
+  switch (code) {
+    case ParseErrorCode::NONE: return "OK";
+    case ParseErrorCode::UNSUPPORTED: return "Commande non supportée";
+    case ParseErrorCode::INVALID_COMMAND: return "Commande invalide";
+    case ParseErrorCode::CORRUPTED_RECORD: return "Enregistrement binaire corrompu";
+    default: return tokenStatusMessage(static_cast<TokenStatus>(code));
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include "../config.h"
+#include "gcode_tokenizer.h"
+
+// Codes d'erreur : les premiers reprennent TokenStatus, les suivants viennent du parser
+enum class ParseErrorCode : uint8_t {
+  NONE = 0,
+  BAD_LINE_NUMBER = static_cast<uint8_t>(TokenStatus::BAD_LINE_NUMBER),
+  BAD_CHECKSUM, UNTERMINATED_COMMENT, BAD_COMMAND, BAD_LETTER, BAD_VALUE,
+  TOO_MANY_WORDS, UNKNOWN_PARAMETER, BAD_EXPRESSION,
+  UNSUPPORTED = 32,   // Commande valide mais absente de la table de dispatch
+  INVALID_COMMAND,    // Paramètres refusés, affectation, sous-programme...
+  CORRUPTED_RECORD    // Enregistrement binaire illisible
+};
+
+enum class ParseErrorPolicy : uint8_t {
+  ABORT, // Arrêt du fichier à la première erreur
+  SKIP,  // Ligne ignorée, erreur enregistrée dans l'anneau
+  COUNT  // Ligne ignorée, erreur seulement comptée
+};
+
+// Erreur compacte : 12 octets, sans texte
+struct ParseErrorRecord {
+  uint32_t offset;  // Octet de début de la ligne (ou de l'enregistrement binaire)
+  uint32_t line;    // Ligne du fichier (ou rang de la commande binaire), à partir de 1
+  uint16_t column;
+  ParseErrorCode code;
+  uint8_t reserved;
+};
+
+// Journal des erreurs du fichier en cours. Appelé sous le verrou de gcodeParser.
+class ParseErrorLog {
+private:
+  ParseErrorRecord ring[PARSE_ERROR_RING_SIZE];
+  ParseErrorRecord first_error;
+  uint8_t next;
+  uint8_t stored;
+  uint32_t total;
+  ParseErrorPolicy policy;
+  volatile bool aborted; // Lu sans verrou par sdTask
+
+public:
+  ParseErrorLog() : policy(static_cast<ParseErrorPolicy>(PARSE_ERROR_POLICY)) { reset(); }
+  void reset(); // Début de fichier
+  void setPolicy(ParseErrorPolicy new_policy) { policy = new_policy; }
+  ParseErrorPolicy currentPolicy() const { return policy; }
+  // Retourne false si le fichier doit être abandonné
+  bool report(ParseErrorCode code, uint32_t line, uint32_t offset, uint16_t column);
+  bool isAborted() const { return aborted; }
+  uint32_t count() const { return total; }
+  const ParseErrorRecord &first() const { return first_error; }
+  // Copie les erreurs les plus récentes, de la plus ancienne à la plus récente
+  uint8_t recent(ParseErrorRecord *out, uint8_t max) const;
+};
+
+const char *parseErrorMessage(ParseErrorCode code);
+
+extern ParseErrorLog parseErrors;
@@ -0,0 +1,73 @@
+#include "line_pool.h"
+#include <esp_heap_caps.h>
+#include "../debug_manager.h"
+
+LineSlabPool linePool;
+
+static inline bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+void LineSlab::set(const char *source, size_t len) {
+  if (len > LINE_SLAB_BYTES - 1) len = LINE_SLAB_BYTES - 1;
+  memcpy(text, source, len);
+  text[len] = '\0';
+  length = len;
+}
+
+void LineSlab::trim() {
+  size_t start = 0;
+  while (start < length && isBlank(text[start])) start++;
+  size_t end = length;
+  while (end > start && isBlank(text[end - 1])) end--;
+  length = end - start;
+  if (start) memmove(text, text + start, length);
+  text[length] = '\0';
+}
+
+bool LineSlabPool::init() {
+  slabs = static_cast<LineSlab *>(heap_caps_malloc(sizeof(LineSlab) * LINE_SLAB_COUNT, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+  if (!slabs) slabs = static_cast<LineSlab *>(heap_caps_malloc(sizeof(LineSlab) * LINE_SLAB_COUNT, MALLOC_CAP_8BIT));
+  free_slabs = xQueueCreate(LINE_SLAB_COUNT, sizeof(LineSlab *));
+  if (!slabs || !free_slabs) {
+    DEBUG_PRINTF_AUTO("Erreur: Impossible d'allouer %u slabs de ligne", (unsigned)LINE_SLAB_COUNT);
+    return false;
+  }
+  for (size_t n = 0; n < LINE_SLAB_COUNT; n++) {
+    LineSlab *slab = &slabs[n];
+    slab->in_pool = true;
+    xQueueSend(free_slabs, &slab, 0);
+  }
+  DEBUG_PRINTF_AUTO("Pool de lignes: %u slabs de %u octets", (unsigned)LINE_SLAB_COUNT, (unsigned)sizeof(LineSlab));
+  return true;
+}
+
+LineSlab *LineSlabPool::acquire(TickType_t ticks_to_wait) {
+  LineSlab *slab;
+  if (xQueueReceive(free_slabs, &slab, ticks_to_wait) != pdTRUE) return NULL;
+  slab->in_pool = false;
+  slab->line_number = slab->offset = 0;
+  slab->length = 0;
+  slab->end_of_file = false;
+  slab->text[0] = '\0';
+  return slab;
+}
+
+void LineSlabPool::recycle(LineSlab *slab) {
+  if (!slab) return;
+  if (slab->in_pool) {
+    DEBUG_PRINTF_AUTO("Erreur: Slab de ligne rendu deux fois");
+    return;
+  }
+  slab->in_pool = true;
+  xQueueSend(free_slabs, &slab, 0); // Jamais plein : LINE_SLAB_COUNT places
+}
+
+void LineSlabPool::drain(QueueHandle_t queue) {
+  LineSlab *slab;
+  while (xQueueReceive(queue, &slab, 0) == pdTRUE) recycle(slab);
+}
+
+size_t LineSlabPool::available() const {
+  return free_slabs ? uxQueueMessagesWaiting(free_slabs) : 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "../config.h"
+
+// Ligne transportée entre tâches. gcodeQueue et sdQueue ne contiennent qu'un pointeur
+// vers un slab du pool : pas d'allocation ni de copie d'objet par ligne.
+// Propriété : le slab appartient à la tâche qui l'a obtenu par acquire(), puis à celle
+// qui le reçoit d'une queue ; un envoi réussi transfère la propriété, un envoi refusé la
+// laisse à l'émetteur. Le dernier propriétaire le rend par recycle().
+struct LineSlab {
+  uint32_t line_number;         // Ligne du fichier, 0 pour la liaison série (sdQueue : ligne ou couche de départ)
+  uint32_t offset;              // Octet de début de la ligne dans le fichier (sdQueue : SdRequest)
+  uint16_t length;
+  bool end_of_file;             // Marqueur envoyé par sdTask après la dernière ligne
+  bool in_pool;                 // Détection des doubles recycle()
+  char text[LINE_SLAB_BYTES];   // Terminé par '\0'
+
+  void set(const char *source, size_t len); // Tronqué à LINE_SLAB_BYTES - 1
+  void trim();                               // Blancs de début et de fin, en place
+};
+
+class LineSlabPool {
+private:
+  LineSlab *slabs;
+  QueueHandle_t free_slabs;     // LineSlab * disponibles
+
+public:
+  LineSlabPool() : slabs(NULL), free_slabs(NULL) {}
+  bool init();                  // LINE_SLAB_COUNT slabs, en PSRAM si disponible
+  LineSlab *acquire(TickType_t ticks_to_wait); // NULL si le pool reste épuisé
+  void recycle(LineSlab *slab);
+  void drain(QueueHandle_t queue); // Vide une queue de slabs en les rendant au pool (remplace xQueueReset)
+  size_t available() const;
+};
+
+extern LineSlabPool linePool;
@@ -0,0 +1,121 @@
+#include "motion_queue.h"
+#include "../debug_manager.h"
+
+MotionQueue motionQueue;
+
+#if MOTION_FIXED_POINT
+static inline uint8_t presentMask(const MotionQueueItem &item) { return item.present; }
+static inline void setPresentMask(MotionQueueItem &item, uint8_t present) { item.present = present; }
+#else
+static inline uint8_t presentMask(const MotionQueueItem &item) {
+  return (item.has(PARAM_X) ? MOTION_HAS_X : 0) | (item.has(PARAM_Y) ? MOTION_HAS_Y : 0) |
+         (item.has(PARAM_Z) ? MOTION_HAS_Z : 0) | (item.has(PARAM_E) ? MOTION_HAS_E : 0) |
+         (item.has(PARAM_F) ? MOTION_HAS_F : 0) | (item.has(PARAM_S) ? MOTION_HAS_S : 0);
+}
+static inline void setPresentMask(MotionQueueItem &item, uint8_t present) {
+  item.params = ((present & MOTION_HAS_X) ? PARAM_X : 0) | ((present & MOTION_HAS_Y) ? PARAM_Y : 0) |
+                ((present & MOTION_HAS_Z) ? PARAM_Z : 0) | ((present & MOTION_HAS_E) ? PARAM_E : 0) |
+                ((present & MOTION_HAS_F) ? PARAM_F : 0) | ((present & MOTION_HAS_S) ? PARAM_S : 0);
+}
+#endif
+
+bool MotionQueue::init() {
+  // Anneau statique : seuls les sémaphores de réveil sont alloués
+  if (!ring.init() || !flow.init(MOTION_QUEUE_HIGH_WATERMARK, MOTION_QUEUE_LOW_WATERMARK)) {
+    DEBUG_PRINTF_AUTO("Erreur: Création des sémaphores de motionQueue impossible");
+    return false;
+  }
+  ready = true;
+  DEBUG_PRINTF_AUTO("motionQueue créée: %u octets, enregistrement max %u octets",
+                    (unsigned)ring.capacity(), (unsigned)MOTION_PACKED_MAX_SIZE);
+  return true;
+}
+
+size_t MotionQueue::pack(const MotionQueueItem &item, uint8_t *out) {
+  PackedMotionHeader header;
+  header.opcode = static_cast<uint16_t>((item.type == 'M' ? 0x8000 : 0) | (item.code & 0x7FFF));
+  header.present = presentMask(item);
+  header.reserved = 0;
+  memcpy(out, &header, sizeof(header));
+
+  const motion_value_t values[6] = {item.x, item.y, item.z, item.e, item.f, item.s};
+  size_t size = sizeof(header);
+  for (uint8_t i = 0; i < 6; i++) {
+    if (header.present & (1 << i)) {
+      memcpy(out + size, &values[i], sizeof(motion_value_t));
+      size += sizeof(motion_value_t);
+    }
+  }
+  return size;
+}
+
+// Taille de l'enregistrement annoncée par son en-tête
+size_t MotionQueue::recordSize(const uint8_t *header) {
+  PackedMotionHeader packed;
+  memcpy(&packed, header, sizeof(packed));
+  return sizeof(packed) + __builtin_popcount(packed.present & 0x3F) * sizeof(motion_value_t);
+}
+
+bool MotionQueue::unpack(const uint8_t *data, size_t size, MotionQueueItem &item) {
+  if (size < sizeof(PackedMotionHeader)) return false;
+  PackedMotionHeader header;
+  memcpy(&header, data, sizeof(header));
+
+  memset(&item, 0, sizeof(item));
+  item.type = (header.opcode & 0x8000) ? 'M' : 'G';
+  item.code = header.opcode & 0x7FFF;
+  setPresentMask(item, header.present);
+
+  motion_value_t *fields[6] = {&item.x, &item.y, &item.z, &item.e, &item.f, &item.s};
+  size_t offset = sizeof(header);
+  for (uint8_t i = 0; i < 6; i++) {
+    if (header.present & (1 << i)) {
+      if (offset + sizeof(motion_value_t) > size) return false;
+      memcpy(fields[i], data + offset, sizeof(motion_value_t));
+      offset += sizeof(motion_value_t);
+    }
+  }
+  return true;
+}
+
+bool MotionQueue::send(const MotionQueueItem &item, TickType_t ticks_to_wait) {
+  uint8_t packed[MOTION_PACKED_MAX_SIZE];
+  size_t size = pack(item, packed);
+  if (!flow.admit([this]() { return usedBytes(); }, ticks_to_wait)) return false;
+  // Un enregistrement est publié d'un seul bloc : le consommateur le voit entier ou pas du tout
+  if (!ring.waitForSpace(size, ticks_to_wait) || !ring.pushAll(packed, size)) return false;
+  sent = sent + 1;
+  return true;
+}
+
+bool MotionQueue::waitForSpace(TickType_t ticks_to_wait) {
+  return flow.admit([this]() { return usedBytes(); }, ticks_to_wait) &&
+         ring.waitForSpace(MOTION_PACKED_MAX_SIZE, ticks_to_wait);
+}
+
+bool MotionQueue::receive(MotionQueueItem &item, TickType_t ticks_to_wait) {
+  uint8_t packed[MOTION_PACKED_MAX_SIZE];
+  if (!ring.waitForData(sizeof(PackedMotionHeader), ticks_to_wait)) return false;
+  ring.popAll(packed, sizeof(PackedMotionHeader));
+  size_t size = recordSize(packed);
+  bool ok = ring.popAll(packed + sizeof(PackedMotionHeader), size - sizeof(PackedMotionHeader)) &&
+            unpack(packed, size, item);
+  received = received + 1;
+  flow.drained(usedBytes());
+  if (!ok) DEBUG_PRINTF_AUTO("Erreur: Enregistrement motionQueue corrompu (%u octets)", (unsigned)size);
+  return ok;
+}
+
+void MotionQueue::reset() {
+  ring.clear();
+  received = sent; // Enregistrements abandonnés : plus rien en attente
+  flow.release();
+}
+
+size_t MotionQueue::freeBytes() const {
+  return ring.freeSpace();
+}
+
+size_t MotionQueue::usedBytes() const {
+  return ring.size();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "gcode_parser.h"
+#include "flow_control.h"
+#include "spsc_ring.h"
+
+#if MOTION_FIXED_POINT
+typedef int32_t motion_value_t;
+#else
+typedef float motion_value_t;
+#endif
+
+// Enregistrement compact transporté par la queue : en-tête de 4 octets suivi
+// uniquement des valeurs présentes (X, Y, Z, E, F, S dans cet ordre)
+struct PackedMotionHeader {
+  uint16_t opcode;  // bit 15 = 'M', bits 0..14 = code
+  uint8_t present;  // MOTION_HAS_X, MOTION_HAS_Y, ...
+  uint8_t reserved;
+};
+
+#define MOTION_PACKED_MAX_SIZE (sizeof(PackedMotionHeader) + 6 * sizeof(motion_value_t))
+
+// File de commandes de mouvement dimensionnée en octets plutôt qu'en nombre d'éléments.
+// Les enregistrements passent par un anneau SPSC d'octets : un producteur à la fois
+// (le parser, sous son verrou) et un seul consommateur.
+class MotionQueue {
+private:
+  SpscRing<uint8_t, MOTION_QUEUE_BYTES> ring;
+  bool ready;
+  FlowControl flow;
+  // Enregistrements publiés et retirés depuis le démarrage : un mouvement envoyé quand
+  // sent valait n est entre les mains du consommateur dès que received atteint n + 1
+  volatile uint32_t sent;
+  volatile uint32_t received;
+
+  static size_t pack(const MotionQueueItem &item, uint8_t *out);
+  static size_t recordSize(const uint8_t *header);
+  static bool unpack(const uint8_t *data, size_t size, MotionQueueItem &item);
+
+public:
+  MotionQueue() : ready(false), sent(0), received(0) {}
+  bool init();
+  bool isReady() const { return ready; }
+  // Au-dessus de MOTION_QUEUE_HIGH_WATERMARK, attend que le consommateur la ramène sous
+  // MOTION_QUEUE_LOW_WATERMARK ; ticks_to_wait borne l'attente sans progrès
+  bool send(const MotionQueueItem &item, TickType_t ticks_to_wait);
+  // Attend, sans rien publier, qu'un enregistrement de taille maximale puisse être admis :
+  // permet au producteur d'attendre sans garder son verrou puis de réessayer send()
+  bool waitForSpace(TickType_t ticks_to_wait);
+  bool receive(MotionQueueItem &item, TickType_t ticks_to_wait);
+  void reset();     // Consommateur, ou producteur à l'arrêt
+  size_t freeBytes() const;
+  size_t usedBytes() const;
+  uint32_t sentCount() const { return sent; }
+  uint32_t receivedCount() const { return received; }
+};
+
+extern MotionQueue motionQueue;
@@ -0,0 +1,562 @@
+#include "gcode_index.h"
+#include <float.h>
+#include <math.h>
+#include <esp_heap_caps.h>
+#include "../debug_manager.h"
+#include "sd_directory.h"
+#include "../gcode_parser/gcode_binary.h"
+
+extern SdFat SD;
+
+GcodeIndexer gcodeIndexer;
+static GcodeParser indexParser; // Parser privé, toujours en dry run
+
+static const MotionCommand kEmptyCommand = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+
+bool GcodeLineReader::begin(File32 &source, uint32_t start_offset) {
+  if (!buffer) buffer = static_cast<char *>(heap_caps_malloc(GCODE_INDEX_READ_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+  if (!buffer) buffer = static_cast<char *>(heap_caps_malloc(GCODE_INDEX_READ_BYTES, MALLOC_CAP_8BIT));
+  if (!buffer) {
+    DEBUG_PRINTF_AUTO("Erreur: Allocation du tampon de lecture d'index impossible");
+    return false;
+  }
+  file = &source;
+  pos = len = 0;
+  offset = start_offset;
+  eof = false;
+  return true;
+}
+
+void GcodeLineReader::end() {
+  heap_caps_free(buffer);
+  buffer = NULL;
+  file = NULL;
+}
+
+bool GcodeLineReader::next(const char *&line, size_t &line_len, uint32_t &line_offset) {
+  while (1) {
+    const char *start = buffer + pos;
+    size_t available = len - pos;
+    const char *newline = available ? static_cast<const char *>(memchr(start, '\n', available)) : NULL;
+    if (!newline && !eof && available < GCODE_INDEX_READ_BYTES) {
+      memmove(buffer, start, available);
+      len = available;
+      pos = 0;
+      int bytesRead = file->read(buffer + len, GCODE_INDEX_READ_BYTES - len);
+      if (bytesRead <= 0) eof = true;
+      else len += bytesRead;
+      continue;
+    }
+    if (available == 0) return false;
+    line = start;
+    line_len = newline ? newline - start : (available < SD_READ_BUFFER_BYTES ? available : SD_READ_BUFFER_BYTES);
+    line_offset = offset;
+    size_t used = newline ? line_len + 1 : line_len;
+    pos += used;
+    offset += used;
+    return true;
+  }
+}
+
+enum class LayerMark : uint8_t { NONE, NUMBERED, NEXT };
+
+// Commentaires de changement de couche des slicers : ;LAYER:<n> (Cura) et ;LAYER_CHANGE,
+// sans casse comme le reste du G-code
+static LayerMark layerComment(const char *line, size_t len, int32_t &layer) {
+  const char *p = line;
+  const char *end = line + len;
+  while (p < end && (*p == ' ' || *p == '\t')) p++;
+  if (end - p < 7 || strncasecmp(p, ";LAYER", 6) != 0) return LayerMark::NONE;
+  p += 6;
+  if (end - p >= 7 && strncasecmp(p, "_CHANGE", 7) == 0) return LayerMark::NEXT;
+  if (*p != ':') return LayerMark::NONE;
+  p++;
+  bool negative = p < end && *p == '-';
+  if (negative) p++;
+  if (p == end || *p < '0' || *p > '9') return LayerMark::NONE;
+  int32_t value = 0;
+  while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+  layer = negative ? -value : value;
+  return LayerMark::NUMBERED;
+}
+
+static String layerFileName(const String &name) {
+  return name + GCODE_INDEX_LAYER_EXTENSION;
+}
+
+// G-code texte d'après l'extension, pour le parcours de SCAN_SD
+static bool isGcodeText(const char *name) {
+  static const char *const extensions[] = {".gcode", ".gco", ".g", ".nc"};
+  size_t len = strlen(name);
+  for (size_t n = 0; n < sizeof(extensions) / sizeof(extensions[0]); n++) {
+    size_t ext = strlen(extensions[n]);
+    if (len > ext && strcasecmp(name + len - ext, extensions[n]) == 0) return true;
+  }
+  return false;
+}
+
+static void printScanResult(const String &name, const GcodeMetadata &meta) {
+  char summary[160];
+  formatGcodeMetadata(meta, summary, sizeof(summary));
+  Serial.printf("OK: Scanned %s %s\n", name.c_str(), summary);
+}
+
+void GcodeIndexer::request(const String &filename, bool build_index) {
+  if (!building) {
+    begin(filename, build_index);
+    return;
+  }
+  const char *kind = build_index ? "Index build" : "Scan";
+  for (uint8_t n = 0; n < queued_count; n++) {
+    const QueuedPass &pass = queued[(queued_head + n) % GCODE_INDEX_QUEUE_LENGTH];
+    if (pass.build_index == build_index && pass.name == filename) {
+      Serial.printf("OK: %s of %s already queued\n", kind, filename.c_str());
+      return;
+    }
+  }
+  if (queued_count == GCODE_INDEX_QUEUE_LENGTH) {
+    DEBUG_PRINTF_AUTO("Erreur: File d'indexation pleine, %s ignoré", filename.c_str());
+    Serial.println("ERROR: SD index queue full");
+    return;
+  }
+  QueuedPass &pass = queued[(queued_head + queued_count) % GCODE_INDEX_QUEUE_LENGTH];
+  pass.name = filename;
+  pass.build_index = build_index;
+  queued_count++;
+  DEBUG_PRINTF_AUTO("%s mis en attente derrière %s", filename.c_str(), name.c_str());
+  Serial.printf("OK: %s of %s queued behind %s\n", kind, filename.c_str(), name.c_str());
+}
+
+// Passe suivante une fois la précédente terminée : demandes en attente, puis parcours de
+// la racine (SCAN_SD sans fichier)
+void GcodeIndexer::startNext() {
+  while (!building && queued_count) {
+    QueuedPass &pass = queued[queued_head];
+    queued_head = (queued_head + 1) % GCODE_INDEX_QUEUE_LENGTH;
+    queued_count--;
+    String filename = pass.name;
+    pass.name = String();
+    begin(filename, pass.build_index);
+  }
+  if (!building && scan_all) scanNext();
+}
+
+bool GcodeIndexer::begin(const String &filename, bool build_index) {
+  if (filename.endsWith(GCODE_BINARY_EXTENSION)) {
+    DEBUG_PRINTF_AUTO("Erreur: Index et résumé réservés aux G-code texte (%s)", filename.c_str());
+    Serial.println(build_index ? "ERROR: Index requires a text G-code file" : "ERROR: Scan requires a text G-code file");
+    return false;
+  }
+  GcodeMetadata cached;
+  if (!build_index && readGcodeMetadata(filename, cached)) {
+    printScanResult(filename, cached);
+    return true;
+  }
+  source = SD.open(filename.c_str(), FILE_READ);
+  if (!source) {
+    DEBUG_PRINTF_AUTO("Erreur: Impossible d'ouvrir %s pour l'indexation", filename.c_str());
+    Serial.println("ERROR: Failed to open file");
+    return false;
+  }
+  name = filename;
+  building = true;
+  with_index = build_index;
+  if (with_index) {
+    index = SD.open((name + GCODE_INDEX_EXTENSION).c_str(), O_RDWR | O_CREAT | O_TRUNC);
+    layers = SD.open(layerFileName(name).c_str(), O_RDWR | O_CREAT | O_TRUNC);
+  }
+  if ((with_index && (!index || !layers)) || !reader.begin(source, 0)) {
+    fail("création des fichiers d'index");
+    return false;
+  }
+  // En-tête provisoire, réécrit par finish() une fois les tables complètes
+  GcodeIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  if (with_index && index.write(&header, sizeof(header)) != sizeof(header)) {
+    fail("écriture de l'en-tête");
+    return false;
+  }
+  indexParser.setDryRun(true);
+  indexParser.resetModalState();
+  indexParser.resetProgram();
+  line_number = line_entries = layer_entries = 0;
+  layer = -1;
+  first_layer = 0;
+  layer_z = 0.0f;
+  comment_layers = false;
+  memset(&meta, 0, sizeof(meta));
+  for (int axis = AXIS_X; axis < AXIS_E; axis++) {
+    meta.min[axis] = FLT_MAX;
+    meta.max[axis] = -FLT_MAX;
+  }
+  max_e = 0.0f;
+  DEBUG_PRINTF_AUTO("%s de %s", with_index ? "Indexation" : "Résumé", name.c_str());
+  return true;
+}
+
+void GcodeIndexer::scanAll() {
+  if (dir) dir.close();
+  dir = SD.open("/");
+  if (!dir) {
+    DEBUG_PRINTF_AUTO("Erreur: Impossible d'ouvrir le répertoire racine");
+    Serial.println("ERROR: Failed to open root directory");
+    return;
+  }
+  scan_all = true;
+  startNext();
+}
+
+// Fichier suivant de la racine sans résumé valable, ou fin du parcours
+void GcodeIndexer::scanNext() {
+  char fileName[256];
+  File32 file;
+  while (file.openNext(&dir, FILE_READ)) {
+    bool candidate = !file.isDir() && file.getName(fileName, sizeof(fileName)) && isGcodeText(fileName);
+    file.close();
+    GcodeMetadata cached;
+    if (!candidate || readGcodeMetadata(fileName, cached)) continue;
+    begin(fileName, false);
+    if (building) return;
+  }
+  dir.close();
+  scan_all = false;
+  Serial.println("OK: SD scan completed");
+}
+
+// Élargit l'enveloppe XY aux points cardinaux du cercle que l'arc franchit
+static void includeArc(const ArcState &arc, float min[], float max[]) {
+  const float kHalfPi = 1.57079633f, kTwoPi = 6.28318531f;
+  for (int quadrant = 0; quadrant < 4; quadrant++) {
+    float angle = quadrant * kHalfPi;
+    // Angle parcouru depuis le départ pour atteindre ce point, dans le sens de l'arc
+    float reached = fmodf(arc.sweep < 0.0f ? arc.start_angle - angle : angle - arc.start_angle, kTwoPi);
+    if (reached < 0.0f) reached += kTwoPi;
+    if (reached > fabsf(arc.sweep)) continue;
+    float x = arc.center_x + arc.radius * cosf(angle);
+    float y = arc.center_y + arc.radius * sinf(angle);
+    if (x < min[AXIS_X]) min[AXIS_X] = x;
+    if (x > max[AXIS_X]) max[AXIS_X] = x;
+    if (y < min[AXIS_Y]) min[AXIS_Y] = y;
+    if (y > max[AXIS_Y]) max[AXIS_Y] = y;
+  }
+}
+
+// Statistiques d'une ligne : chemin parcouru entre les deux états, hors homing. arc est
+// l'arc ouvert par la ligne (NULL sinon) : son chemin suit le cercle, pas la corde.
+void GcodeIndexer::account(const MotionCommand &cmd, ParseStatus status, const ModalState &before,
+                           const ModalState &after, const ArcState *arc) {
+  if (status == ParseStatus::OK && cmd.type == 'G' && cmd.code <= 3) meta.moves++;
+  if (after.position[AXIS_E] > max_e) max_e = after.position[AXIS_E];
+  if (cmd.type == 'G' && cmd.code == 28) return;
+  float distance = 0.0f;
+  if (arc) {
+    // Hélice : longueur de l'arc en XY, Z réparti linéairement
+    float length = fabsf(arc->sweep) * arc->radius;
+    float dz = after.position[AXIS_Z] - before.position[AXIS_Z];
+    distance = length * length + dz * dz;
+  } else {
+    for (int axis = AXIS_X; axis < AXIS_E; axis++) {
+      float delta = after.position[axis] - before.position[axis];
+      distance += delta * delta;
+    }
+  }
+  if (distance == 0.0f) {
+    // Rétraction ou amorçage seuls : durée comptée sur E
+    float retract = after.position[AXIS_E] - before.position[AXIS_E];
+    if (after.feedrate > 0.0f) meta.seconds += fabsf(retract) / after.feedrate;
+    return;
+  }
+  for (int axis = AXIS_X; axis < AXIS_E; axis++) {
+    if (after.position[axis] < meta.min[axis]) meta.min[axis] = after.position[axis];
+    if (after.position[axis] > meta.max[axis]) meta.max[axis] = after.position[axis];
+  }
+  if (arc) includeArc(*arc, meta.min, meta.max);
+  if (after.feedrate > 0.0f) meta.seconds += sqrtf(distance) / after.feedrate;
+}
+
+bool GcodeIndexer::writeEntry(File32 &file, uint32_t offset, const ModalState &state, bool program) {
+  GcodeIndexEntry entry;
+  entry.offset = offset;
+  entry.line = line_number;
+  entry.layer = layer;
+  entry.flags = program ? GCODE_INDEX_PROGRAM_STATE : 0;
+  entry.modal = state;
+  if (file.write(&entry, sizeof(entry)) == sizeof(entry)) return true;
+  fail("écriture d'une entrée");
+  return false;
+}
+
+void GcodeIndexer::step() {
+  startNext();
+  size_t processed = 0;
+  while (building && processed < GCODE_INDEX_STEP_BYTES) {
+    const char *line;
+    size_t len;
+    uint32_t offset;
+    if (!reader.next(line, len, offset)) {
+      finish();
+      return;
+    }
+    processed += len + 1;
+    line_number++;
+    ModalState before = indexParser.modalState();
+    bool program = indexParser.hasProgramState();
+
+    int32_t announced = 0;
+    LayerMark mark = with_index ? layerComment(line, len, announced) : LayerMark::NONE;
+    if (mark != LayerMark::NONE) {
+      if (!comment_layers) {
+        // Le slicer annonce ses couches : celles déduites de Z jusqu'ici sont abandonnées
+        comment_layers = true;
+        layer = -1;
+        layer_entries = 0;
+        layers.seekSet(0);
+      }
+      layer = mark == LayerMark::NUMBERED ? announced : layer + 1;
+      if (layer_entries == 0) first_layer = layer;
+      if (!writeEntry(layers, offset, before, program)) return;
+      layer_entries++;
+    }
+    if (with_index && (line_number - 1) % GCODE_INDEX_LINE_STRIDE == 0) {
+      if (!writeEntry(index, offset, before, program)) return;
+      line_entries++;
+    }
+
+    MotionCommand cmd = kEmptyCommand;
+    uint32_t arcs = indexParser.arcState().started;
+    ParseStatus status = indexParser.parseLine(line, len, cmd);
+    if (status == ParseStatus::OK) indexParser.emitCommand(cmd); // Arcs achevés
+    bool arc = status == ParseStatus::OK && indexParser.arcState().started != arcs;
+    account(cmd, status, before, indexParser.modalState(), arc ? &indexParser.arcState() : NULL);
+    float z = indexParser.modalState().position[AXIS_Z];
+    if (with_index && !comment_layers && z > layer_z + GCODE_INDEX_LAYER_MIN_DZ) {
+      // Sans commentaire de couche : une couche commence à chaque nouveau Z maximal
+      layer_z = z;
+      layer++;
+      if (layer_entries == 0) first_layer = layer;
+      if (!writeEntry(layers, offset, before, program)) return;
+      layer_entries++;
+    }
+  }
+}
+
+void GcodeIndexer::finish() {
+  reader.end();
+  meta.magic = GCODE_META_MAGIC;
+  meta.version = GCODE_META_VERSION;
+  meta.source_size = source.fileSize();
+  meta.source_date = meta.source_time = 0;
+  source.getModifyDateTime(&meta.source_date, &meta.source_time);
+  meta.lines = line_number;
+  meta.material_mm3 = max_e * GCODE_META_E_AREA_MM2;
+  for (int axis = AXIS_X; axis < AXIS_E; axis++) {
+    if (meta.min[axis] > meta.max[axis]) meta.min[axis] = meta.max[axis] = 0.0f; // Aucun déplacement
+  }
+
+  if (with_index) {
+    GcodeIndexEntry entry;
+    layers.seekSet(0);
+    for (uint32_t n = 0; n < layer_entries; n++) {
+      if (layers.read(&entry, sizeof(entry)) != sizeof(entry) || index.write(&entry, sizeof(entry)) != sizeof(entry)) {
+        fail("copie de la table des couches");
+        return;
+      }
+    }
+    GcodeIndexHeader header;
+    header.magic = GCODE_INDEX_MAGIC;
+    header.version = GCODE_INDEX_VERSION;
+    header.entry_size = sizeof(GcodeIndexEntry);
+    header.source_size = meta.source_size;
+    header.source_date = meta.source_date;
+    header.source_time = meta.source_time;
+    header.line_stride = GCODE_INDEX_LINE_STRIDE;
+    header.line_entries = line_entries;
+    header.layer_entries = layer_entries;
+    header.layer_table = sizeof(GcodeIndexHeader) + line_entries * sizeof(GcodeIndexEntry);
+    header.first_layer = first_layer;
+    if (!index.seekSet(0) || index.write(&header, sizeof(header)) != sizeof(header)) {
+      fail("écriture de l'en-tête");
+      return;
+    }
+    index.close();
+    layers.close();
+    SD.remove(layerFileName(name).c_str());
+  }
+  source.close();
+  building = false;
+
+  // Résumé : un échec d'écriture le laisse simplement à recalculer
+  String meta_name = name + GCODE_META_EXTENSION;
+  File32 file = SD.open(meta_name.c_str(), O_RDWR | O_CREAT | O_TRUNC);
+  bool written = file && file.write(&meta, sizeof(meta)) == sizeof(meta);
+  if (file) file.close();
+  if (!written) {
+    DEBUG_PRINTF_AUTO("Erreur: Écriture du résumé de %s impossible", name.c_str());
+    SD.remove(meta_name.c_str());
+  }
+  sdDirectory.invalidate(); // Résumé nouveau ou retiré : l'arborescence en cache est périmée
+
+  if (with_index) {
+    DEBUG_PRINTF_AUTO("Index de %s: %lu lignes, %lu couches (%s)", name.c_str(), (unsigned long)line_number,
+                      (unsigned long)layer_entries, comment_layers ? "commentaires" : "Z");
+    Serial.printf("OK: Index built for %s (%lu lines, %lu layers)\n", name.c_str(), (unsigned long)line_number,
+                  (unsigned long)layer_entries);
+  } else {
+    printScanResult(name, meta);
+  }
+  startNext();
+}
+
+// Échec d'indexation : signalé sans arrêt d'urgence, le fichier reste jouable depuis le début
+void GcodeIndexer::fail(const char *reason) {
+  DEBUG_PRINTF_AUTO("Erreur: Indexation de %s interrompue (%s)", name.c_str(), reason);
+  Serial.println("ERROR: SD index build failed");
+  abort();
+}
+
+void GcodeIndexer::abort() {
+  if (!building) return;
+  reader.end();
+  source.close();
+  if (with_index) {
+    index.close();
+    layers.close();
+    SD.remove((name + GCODE_INDEX_EXTENSION).c_str());
+    SD.remove(layerFileName(name).c_str());
+  }
+  building = false;
+}
+
+static bool readEntry(File32 &index, uint32_t position, GcodeIndexEntry &entry) {
+  return index.seekSet(position) && index.read(&entry, sizeof(entry)) == sizeof(entry);
+}
+
+// Entrée de la couche demandée : accès direct si les couches sont numérotées à la suite,
+// recherche dichotomique sinon
+static GcodeSeekResult findLayer(File32 &index, const GcodeIndexHeader &header, int32_t target,
+                                 GcodeIndexEntry &entry) {
+  if (header.layer_entries == 0) return GcodeSeekResult::OUT_OF_RANGE;
+  int64_t guess = static_cast<int64_t>(target) - header.first_layer;
+  if (guess >= 0 && guess < header.layer_entries) {
+    if (!readEntry(index, header.layer_table + guess * sizeof(GcodeIndexEntry), entry)) return GcodeSeekResult::READ_ERROR;
+    if (entry.layer == target) return GcodeSeekResult::OK;
+  }
+  uint32_t low = 0, high = header.layer_entries;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (!readEntry(index, header.layer_table + mid * sizeof(GcodeIndexEntry), entry)) return GcodeSeekResult::READ_ERROR;
+    if (entry.layer == target) return GcodeSeekResult::OK;
+    if (entry.layer < target) low = mid + 1;
+    else high = mid;
+  }
+  return GcodeSeekResult::OUT_OF_RANGE;
+}
+
+GcodeSeekResult seekGcodeFile(File32 &source, const String &filename, bool by_layer, int32_t target,
+                              uint32_t &line_number, uint32_t &offset) {
+  File32 index = SD.open((filename + GCODE_INDEX_EXTENSION).c_str(), FILE_READ);
+  GcodeIndexHeader header;
+  uint16_t date = 0, time = 0;
+  source.getModifyDateTime(&date, &time);
+  if (!index || index.read(&header, sizeof(header)) != sizeof(header) || header.magic != GCODE_INDEX_MAGIC ||
+      header.version != GCODE_INDEX_VERSION || header.entry_size != sizeof(GcodeIndexEntry) ||
+      header.source_size != source.fileSize() || header.source_date != date || header.source_time != time) {
+    index.close();
+    return GcodeSeekResult::NO_INDEX;
+  }
+
+  GcodeIndexEntry entry;
+  GcodeSeekResult result;
+  if (by_layer) {
+    result = findLayer(index, header, target, entry);
+  } else if (header.line_entries == 0) {
+    result = GcodeSeekResult::OUT_OF_RANGE;
+  } else {
+    if (target < 1) target = 1;
+    uint32_t k = static_cast<uint32_t>(target - 1) / header.line_stride;
+    if (k >= header.line_entries) k = header.line_entries - 1;
+    result = readEntry(index, sizeof(GcodeIndexHeader) + k * sizeof(GcodeIndexEntry), entry) ? GcodeSeekResult::OK
+                                                                                                : GcodeSeekResult::READ_ERROR;
+  }
+  index.close();
+  if (result != GcodeSeekResult::OK) return result;
+  if (entry.flags & GCODE_INDEX_PROGRAM_STATE) return GcodeSeekResult::PROGRAM_STATE;
+
+  gcodeParser.restoreModalState(entry.modal);
+  line_number = entry.line;
+  offset = entry.offset;
+  if (!source.seekSet(offset)) return GcodeSeekResult::READ_ERROR;
+  if (by_layer || static_cast<uint32_t>(target) == line_number) return GcodeSeekResult::OK;
+
+  // Lignes entre l'entrée et la cible : état modal mis à jour, aucun mouvement
+  GcodeLineReader reader;
+  if (!reader.begin(source, offset)) return GcodeSeekResult::READ_ERROR;
+  gcodeParser.setDryRun(true);
+  while (line_number < static_cast<uint32_t>(target) && result == GcodeSeekResult::OK) {
+    const char *line;
+    size_t len;
+    uint32_t line_offset;
+    if (!reader.next(line, len, line_offset)) {
+      result = GcodeSeekResult::OUT_OF_RANGE;
+      break;
+    }
+    MotionCommand cmd = kEmptyCommand;
+    if (gcodeParser.parseLine(line, len, cmd) == ParseStatus::OK) gcodeParser.emitCommand(cmd);
+    line_number++;
+    offset = reader.position();
+  }
+  gcodeParser.setDryRun(false);
+  reader.end();
+  if (result == GcodeSeekResult::OK && gcodeParser.hasProgramState()) result = GcodeSeekResult::PROGRAM_STATE;
+  if (result == GcodeSeekResult::OK && !source.seekSet(offset)) result = GcodeSeekResult::READ_ERROR;
+  return result;
+}
+
+const char *gcodeSeekMessage(GcodeSeekResult result) {
+  switch (result) {
+    case GcodeSeekResult::OK: return "OK";
+    case GcodeSeekResult::NO_INDEX: return "No valid index for file (run INDEX_SD)";
+    case GcodeSeekResult::OUT_OF_RANGE: return "Layer or line out of range";
+    case GcodeSeekResult::PROGRAM_STATE: return "Cannot resume after subroutines or variables";
+    case GcodeSeekResult::READ_ERROR: return "SD index read failed";
+  }
+  return "Unknown seek error";
+}
+
+bool isGcodeSidecar(const char *name) {
+  static const char *const extensions[] = {GCODE_INDEX_EXTENSION, GCODE_INDEX_LAYER_EXTENSION, GCODE_META_EXTENSION};
+  size_t len = strlen(name);
+  for (size_t n = 0; n < sizeof(extensions) / sizeof(extensions[0]); n++) {
+    size_t ext = strlen(extensions[n]);
+    if (len > ext && strcasecmp(name + len - ext, extensions[n]) == 0) return true;
+  }
+  return false;
+}
+
+bool readGcodeMetadata(const String &filename, GcodeMetadata &meta) {
+  File32 source = SD.open(filename.c_str(), FILE_READ);
+  if (!source) return false;
+  uint16_t date = 0, time = 0;
+  source.getModifyDateTime(&date, &time);
+  uint32_t size = source.fileSize();
+  source.close();
+  File32 file = SD.open((filename + GCODE_META_EXTENSION).c_str(), FILE_READ);
+  if (!file) return false;
+  bool read = file.read(&meta, sizeof(meta)) == sizeof(meta);
+  file.close();
+  return read && isGcodeMetadataValid(meta, size, date, time);
+}
+
+bool isGcodeMetadataValid(const GcodeMetadata &meta, uint32_t size, uint16_t date, uint16_t time) {
+  return meta.magic == GCODE_META_MAGIC && meta.version == GCODE_META_VERSION &&
+         meta.source_size == size && meta.source_date == date && meta.source_time == time;
+}
+
+int formatGcodeMetadata(const GcodeMetadata &meta, char *out, size_t size) {
+  uint32_t seconds = static_cast<uint32_t>(meta.seconds + 0.5f);
+  return snprintf(out, size, "lines=%lu moves=%lu x=%.1f..%.1f y=%.1f..%.1f z=%.1f..%.1f time=%lu:%02lu:%02lu material=%.0fmm3",
+                  (unsigned long)meta.lines, (unsigned long)meta.moves, meta.min[AXIS_X], meta.max[AXIS_X],
+                  meta.min[AXIS_Y], meta.max[AXIS_Y], meta.min[AXIS_Z], meta.max[AXIS_Z],
+                  (unsigned long)(seconds / 3600), (unsigned long)(seconds / 60 % 60), (unsigned long)(seconds % 60),
+                  meta.material_mm3);
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include "../config.h"
+#include "gcode_parser.h"
+
+// Index d'un G-code texte, dans un fichier voisin <nom>GCODE_INDEX_EXTENSION :
+//   en-tête | une entrée toutes les GCODE_INDEX_LINE_STRIDE lignes | une entrée par couche
+// Chaque entrée donne la position d'un début de ligne et l'état modal du parser juste
+// avant cette ligne : une reprise lit une entrée à une position calculée, s'y place et
+// rejoue au plus GCODE_INDEX_LINE_STRIDE - 1 lignes sans mouvement.
+#define GCODE_INDEX_MAGIC 0x58444947UL // "GIDX"
+#define GCODE_INDEX_VERSION 1
+
+// Entrée précédée de variables ou de sous-programmes : reprise impossible à cet endroit
+#define GCODE_INDEX_PROGRAM_STATE (1 << 0)
+
+struct GcodeIndexHeader {
+  uint32_t magic;              // Écrit en dernier : 0 tant que l'index est incomplet
+  uint16_t version;
+  uint16_t entry_size;         // sizeof(GcodeIndexEntry) du firmware qui l'a produit
+  uint32_t source_size;        // Taille et date FAT du G-code indexé : index périmé sinon
+  uint16_t source_date, source_time;
+  uint32_t line_stride;
+  uint32_t line_entries;
+  uint32_t layer_entries;
+  uint32_t layer_table;        // Position de la première entrée de couche
+  int32_t first_layer;         // Numéro de la première couche
+};
+
+struct GcodeIndexEntry {
+  uint32_t offset;             // Début de ligne dans le G-code
+  uint32_t line;               // Numéro de cette ligne (1 = première)
+  int32_t layer;               // Couche en cours, -1 avant la première
+  uint32_t flags;
+  ModalState modal;            // État avant l'exécution de la ligne
+};
+
+// Résumé d'un G-code texte, écrit dans <nom>GCODE_META_EXTENSION à la fin de chaque passe
+// (SCAN_SD ou INDEX_SD) et valable tant que la taille et la date FAT du G-code n'ont pas
+// changé : lister la carte ne relance aucune passe
+#define GCODE_META_MAGIC 0x4154454DUL // "META"
+#define GCODE_META_VERSION 1
+
+struct GcodeMetadata {
+  uint32_t magic;
+  uint16_t version, reserved;
+  uint32_t source_size;
+  uint16_t source_date, source_time;
+  uint32_t lines;
+  uint32_t moves;              // G0 à G3 du fichier (hors sous-programmes)
+  float min[AXIS_E], max[AXIS_E]; // Enveloppe XYZ des positions atteintes, mm machine
+  float seconds;               // Longueur / vitesse programmée : sans accélérations ni chauffe
+  float material_mm3;          // E machine maximal atteint x GCODE_META_E_AREA_MM2
+};
+
+// Découpage en lignes d'un fichier lu par blocs, identique à celui de la lecture SD :
+// une ligne sans '\n' tenant pas dans le tampon est coupée à SD_READ_BUFFER_BYTES
+class GcodeLineReader {
+private:
+  File32 *file;
+  char *buffer;                // GCODE_INDEX_READ_BYTES, alloué par begin()
+  size_t pos, len;
+  uint32_t offset;             // Position dans le fichier de buffer[pos]
+  bool eof;
+
+public:
+  GcodeLineReader() : file(NULL), buffer(NULL), pos(0), len(0), offset(0), eof(true) {}
+  bool begin(File32 &source, uint32_t start_offset); // source déjà placée à start_offset
+  void end();
+  // Ligne suivante sans '\n' ; false en fin de fichier
+  bool next(const char *&line, size_t &line_len, uint32_t &line_offset);
+  uint32_t position() const { return offset; } // Début de la ligne suivante
+};
+
+// Passe de construction de l'index et du résumé, par pas, entre deux fichiers joués par
+// sdTask. Sans index demandé, seul le résumé est écrit (SCAN_SD). Une demande reçue
+// pendant une passe attend la fin de celle-ci.
+class GcodeIndexer {
+private:
+  struct QueuedPass {
+    String name;
+    bool build_index;
+  };
+
+  File32 source, index, layers;
+  File32 dir;                  // SCAN_SD sans fichier : parcours de la racine
+  GcodeLineReader reader;
+  GcodeMetadata meta;
+  float max_e;                 // E machine le plus haut atteint
+  String name;
+  uint32_t line_number;
+  uint32_t line_entries, layer_entries;
+  int32_t layer, first_layer;
+  float layer_z;               // Z le plus haut atteint (couches déduites de Z)
+  bool comment_layers;         // Couches annoncées par ;LAYER:<n> ou ;LAYER_CHANGE
+  bool building;
+  bool with_index;
+  bool scan_all;
+  QueuedPass queued[GCODE_INDEX_QUEUE_LENGTH];
+  uint8_t queued_head, queued_count;
+
+  bool begin(const String &filename, bool build_index);
+  void startNext();
+  bool writeEntry(File32 &file, uint32_t offset, const ModalState &state, bool program);
+  void account(const MotionCommand &cmd, ParseStatus status, const ModalState &before, const ModalState &after,
+               const ArcState *arc);
+  void finish();
+  void fail(const char *reason);
+  void scanNext();
+
+public:
+  GcodeIndexer() : max_e(0.0f), line_number(0), line_entries(0), layer_entries(0), layer(-1), first_layer(0),
+                   layer_z(0.0f), comment_layers(false), building(false), with_index(false), scan_all(false),
+                   queued_head(0), queued_count(0) {}
+  bool isBuilding() const { return building || scan_all || queued_count; }
+  // Passe commencée aussitôt ou mise en attente ; sans index, un résumé encore valable est
+  // rendu tel quel
+  void request(const String &filename, bool build_index = true);
+  void scanAll();                     // Résumé des G-code texte de la racine qui n'en ont pas
+  void step();                        // Traite au plus GCODE_INDEX_STEP_BYTES
+  void abort();
+};
+
+enum class GcodeSeekResult : uint8_t {
+  OK, NO_INDEX, OUT_OF_RANGE, PROGRAM_STATE, READ_ERROR
+};
+
+// Place source au début de la ligne (by_layer = false) ou de la couche demandée (raft
+// Cura en négatif) et restaure l'état modal de gcodeParser, verrou pris par l'appelant.
+// line_number et offset reçoivent la position atteinte.
+GcodeSeekResult seekGcodeFile(File32 &source, const String &filename, bool by_layer, int32_t target,
+                              uint32_t &line_number, uint32_t &offset);
+const char *gcodeSeekMessage(GcodeSeekResult result);
+
+bool isGcodeSidecar(const char *name); // .idx, .idl et .meta (sans casse), masqués par LIST_SD
+// Résumé en cache de filename, false s'il manque ou si le G-code a changé depuis
+bool readGcodeMetadata(const String &filename, GcodeMetadata &meta);
+// Résumé lu ailleurs, comparé à la taille et à la date FAT du G-code
+bool isGcodeMetadataValid(const GcodeMetadata &meta, uint32_t size, uint16_t date, uint16_t time);
+int formatGcodeMetadata(const GcodeMetadata &meta, char *out, size_t size);
+
+extern GcodeIndexer gcodeIndexer;
@@ -0,0 +1,264 @@
+#include "print_checkpoint.h"
+#include <stddef.h>
+#include <esp_crc.h>
+#include <esp_timer.h>
+#include "../debug_manager.h"
+#include "sd_read_ahead.h"
+
+extern SdFat SD;
+
+PrintCheckpoint printCheckpoint;
+
+static_assert(sizeof(PrintCheckpointRecord) <= CHECKPOINT_SECTOR_BYTES, "PrintCheckpointRecord: un secteur au plus");
+static uint8_t sector[CHECKPOINT_SECTOR_BYTES] __attribute__((aligned(4)));
+
+static const MotionCommand kEmptyCommand = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+
+static uint32_t recordCrc(const PrintCheckpointRecord &record) {
+  return esp_crc32_le(0, reinterpret_cast<const uint8_t *>(&record), offsetof(PrintCheckpointRecord, crc));
+}
+
+static bool isValid(const PrintCheckpointRecord &record) {
+  return record.magic == CHECKPOINT_MAGIC && record.version == CHECKPOINT_VERSION &&
+         record.filename[CHECKPOINT_NAME_BYTES - 1] == '\0' && record.crc == recordCrc(record);
+}
+
+bool PrintCheckpoint::init() {
+  const uint32_t size = CHECKPOINT_SLOTS * CHECKPOINT_SECTOR_BYTES;
+  File32 file = SD.open(CHECKPOINT_FILE, FILE_READ);
+  if (!file || file.fileSize() != size || !file.isContiguous()) {
+    if (file) file.close();
+    SD.remove(CHECKPOINT_FILE);
+    if (!file.createContiguous(CHECKPOINT_FILE, size)) {
+      DEBUG_PRINTF_AUTO("Erreur: Impossible de réserver %s, points de reprise désactivés", CHECKPOINT_FILE);
+      return false;
+    }
+    DEBUG_PRINTF_AUTO("%s réservé: %u secteurs contigus", CHECKPOINT_FILE, (unsigned)CHECKPOINT_SLOTS);
+  }
+  uint32_t first = file.firstSector();
+  file.close();
+
+  // Le plus récent des enregistrements intacts, quel que soit l'emplacement
+  bool found = false;
+  for (uint32_t slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+    if (!SD.card()->readSector(first + slot, sector)) {
+      DEBUG_PRINTF_AUTO("Erreur: Lecture du secteur de reprise %lu impossible", (unsigned long)slot);
+      return false;
+    }
+    PrintCheckpointRecord record;
+    memcpy(&record, sector, sizeof(record));
+    if (!isValid(record)) continue;
+    if (!found || static_cast<int32_t>(record.sequence - last.sequence) > 0) {
+      last = record;
+      found = true;
+    }
+  }
+  first_sector = first;
+  if (found && last.state == CHECKPOINT_ACTIVE) {
+    DEBUG_PRINTF_AUTO("Impression interrompue: %s, ligne %lu", last.filename, (unsigned long)last.line_number + 1);
+  }
+  return true;
+}
+
+bool PrintCheckpoint::write(const Capture &capture) {
+  if (!first_sector) return false;
+  PrintCheckpointRecord record = current;
+  record.magic = CHECKPOINT_MAGIC;
+  record.sequence = last.sequence + 1;
+  record.version = CHECKPOINT_VERSION;
+  record.state = capture.state;
+  record.line_number = capture.line_number;
+  record.offset = capture.offset;
+  record.modal = capture.modal;
+  record.thermal = capture.thermal;
+  record.crc = recordCrc(record);
+  memset(sector, 0, sizeof(sector));
+  memcpy(sector, &record, sizeof(record));
+
+  // Un secteur entier, écrit entre deux blocs de ReadAheadTask
+  sdReadAhead.lockCard();
+  bool ok = SD.card()->writeSector(first_sector + record.sequence % CHECKPOINT_SLOTS, sector);
+  sdReadAhead.unlockCard();
+  if (!ok) {
+    DEBUG_PRINTF_AUTO("Erreur: Écriture du point de reprise %lu impossible", (unsigned long)record.sequence);
+    return false;
+  }
+  last = record;
+  writes++;
+  return true;
+}
+
+void PrintCheckpoint::begin(File32 &source, const String &filename, uint32_t line_number, uint32_t offset) {
+  tracking = false;
+  pending_count = 0;
+  if (!first_sector) return;
+  if (filename.length() >= CHECKPOINT_NAME_BYTES) {
+    DEBUG_PRINTF_AUTO("Erreur: Nom trop long pour un point de reprise: %s", filename.c_str());
+    return;
+  }
+  memset(&current, 0, sizeof(current));
+  memcpy(current.filename, filename.c_str(), filename.length());
+  current.source_size = source.fileSize();
+  source.getModifyDateTime(&current.source_date, &current.source_time);
+  writes = 0;
+  interval_ms = CHECKPOINT_INTERVAL_MS;
+  elapsed_us = 0;
+  started_us = esp_timer_get_time();
+
+  // Point de départ écrit tout de suite : celui d'une impression précédente ne sert plus
+  Capture start = {motionQueue.sentCount(), line_number, offset, gcodeParser.modalState(),
+                   gcodeParser.thermalState(), CHECKPOINT_ACTIVE};
+  write(start);
+  spent_us = esp_timer_get_time() - started_us;
+  last_capture_ms = millis();
+  tracking = true;
+}
+
+void PrintCheckpoint::push(const Capture &capture) {
+  if (pending_count == CHECKPOINT_PENDING) pending_count--; // Remplace la plus récente
+  pending[pending_count++] = capture;
+}
+
+void PrintCheckpoint::capture(uint32_t line_number, uint32_t offset) {
+  last_capture_ms = millis();
+  // Variables ou sous-programmes définis plus haut seraient perdus : le point précédent reste valable
+  if (gcodeParser.hasProgramState()) return;
+  gcodeParser.flushMotion(); // Le mouvement retenu par la fusion appartient aux lignes précédentes
+  int64_t started = esp_timer_get_time();
+  Capture point = {motionQueue.sentCount(), line_number, offset, gcodeParser.modalState(),
+                   gcodeParser.thermalState(), CHECKPOINT_ACTIVE};
+  push(point);
+  spent_us += esp_timer_get_time() - started;
+}
+
+void PrintCheckpoint::finish() {
+  if (!tracking) return;
+  tracking = false;
+  elapsed_us = esp_timer_get_time() - started_us;
+  // Plus rien à reprendre une fois le dernier mouvement retiré de motionQueue
+  Capture end = {motionQueue.sentCount(), 0, 0, gcodeParser.modalState(), gcodeParser.thermalState(), CHECKPOINT_IDLE};
+  push(end);
+  DEBUG_PRINTF_AUTO("Points de reprise: %lu écrits en %lu us sur %lu ms", (unsigned long)writes,
+                    (unsigned long)spent_us, (unsigned long)(elapsed_us / 1000));
+}
+
+void PrintCheckpoint::persistExecuted() {
+  int64_t started = esp_timer_get_time();
+  // Seule la plus récente des captures exécutées est écrite
+  uint32_t received = motionQueue.receivedCount();
+  uint8_t executed = 1;
+  while (executed < pending_count && static_cast<int32_t>(received - pending[executed].motion_sent) >= 0) executed++;
+  write(pending[executed - 1]);
+  pending_count -= executed;
+  memmove(pending, pending + executed, pending_count * sizeof(Capture));
+  int64_t now = esp_timer_get_time();
+  spent_us += now - started;
+
+  // Coût mesuré sur la durée de l'impression : au-delà du seuil, les captures s'espacent
+  if (tracking && spent_us * 1000 > (now - started_us) * CHECKPOINT_MAX_OVERHEAD_PERMILLE &&
+      interval_ms < CHECKPOINT_INTERVAL_MAX_MS) {
+    interval_ms = interval_ms * 2 < CHECKPOINT_INTERVAL_MAX_MS ? interval_ms * 2 : CHECKPOINT_INTERVAL_MAX_MS;
+    DEBUG_PRINTF_AUTO("Points de reprise: intervalle porté à %lu ms", (unsigned long)interval_ms);
+  }
+}
+
+bool PrintCheckpoint::resumableFile(String &filename) const {
+  if (last.state != CHECKPOINT_ACTIVE) return false;
+  filename = last.filename;
+  return true;
+}
+
+// Ligne d'approche : un échec d'envoi à motionQueue est rendu comme une ligne invalide
+static ParseStatus runResumeLine(const char *line) {
+  MotionCommand cmd = kEmptyCommand;
+  DEBUG_PRINTF_AUTO("Reprise: %s", line);
+  ParseStatus status = gcodeParser.parseLine(line, strlen(line), cmd);
+  if (status == ParseStatus::OK && !gcodeParser.emitCommand(cmd)) status = ParseStatus::INVALID;
+  if (status != ParseStatus::OK && status != ParseStatus::CONSUMED) {
+    DEBUG_PRINTF_AUTO("Erreur: Ligne de reprise rejetée: %s", line);
+  }
+  return status;
+}
+
+static bool resumeLineFailed(const char *line) {
+  ParseStatus status = runResumeLine(line);
+  return status != ParseStatus::OK && status != ParseStatus::CONSUMED;
+}
+
+CheckpointResult PrintCheckpoint::restore(File32 &source, uint32_t &line_number, uint32_t &offset) {
+  if (last.state != CHECKPOINT_ACTIVE) return CheckpointResult::NONE;
+  uint16_t date = 0, time = 0;
+  source.getModifyDateTime(&date, &time);
+  if (source.fileSize() != last.source_size || date != last.source_date || time != last.source_time) {
+    return CheckpointResult::STALE;
+  }
+  if (!source.seekSet(last.offset)) return CheckpointResult::READ_ERROR;
+
+  // Après la coupure, l'exécuteur repart de zéro sur tous ses axes. X et Y sont refaits
+  // par G28 ; Z et E ne peuvent pas l'être pièce en place : la hauteur est supposée
+  // conservée (axe Z freiné) et la position machine repart de zéro à cet endroit, le
+  // décalage G92 absorbant l'écart pour la suite du programme.
+  ModalState resumed = last.modal;
+  for (int axis = AXIS_Z; axis <= AXIS_E; axis++) {
+    resumed.offset[axis] -= resumed.position[axis];
+    resumed.position[axis] = 0.0f;
+  }
+
+  // Approche en coordonnées machine, Z compté depuis la hauteur d'arrêt (Z0) : montée de
+  // CHECKPOINT_RESUME_LIFT_MM au-dessus de la pièce, chauffe, homing XY, retour en XY puis
+  // descente en Z0, la position que resumed attend pour Z
+  const ThermalState &thermal = last.thermal;
+  char line[64];
+  gcodeParser.discardMotion();
+  gcodeParser.resetModalState();
+  snprintf(line, sizeof(line), "G0 Z%.3f F%d", CHECKPOINT_RESUME_LIFT_MM, CHECKPOINT_RESUME_FEEDRATE);
+  bool failed = resumeLineFailed(line);
+  if (!failed && thermal.bed > 0.0f) {
+    snprintf(line, sizeof(line), "M140 S%.1f", thermal.bed);
+    failed = resumeLineFailed(line);
+  }
+  if (!failed && thermal.hotend > 0.0f) {
+    snprintf(line, sizeof(line), "M109 S%.1f", thermal.hotend);
+    failed = resumeLineFailed(line);
+  }
+  if (!failed && thermal.bed > 0.0f) {
+    snprintf(line, sizeof(line), "M190 S%.1f", thermal.bed);
+    failed = resumeLineFailed(line);
+  }
+  if (!failed) failed = resumeLineFailed("G28 X0 Y0");
+  if (!failed) {
+    snprintf(line, sizeof(line), "G0 X%.3f Y%.3f", resumed.position[AXIS_X], resumed.position[AXIS_Y]);
+    failed = resumeLineFailed(line);
+  }
+  if (!failed) failed = resumeLineFailed("G0 Z0");
+  if (!failed) {
+    if (thermal.fan > 0.0f) snprintf(line, sizeof(line), "M106 S%.0f", thermal.fan);
+    else snprintf(line, sizeof(line), "M107");
+    failed = resumeLineFailed(line);
+  }
+  if (failed) return CheckpointResult::APPROACH_FAILED;
+  gcodeParser.restoreModalState(resumed);
+
+  line_number = last.line_number;
+  offset = last.offset;
+  return CheckpointResult::OK;
+}
+
+// Coût du suivi sur l'impression en cours ou la dernière terminée
+void PrintCheckpoint::printStats() {
+  int64_t elapsed = tracking ? esp_timer_get_time() - started_us : elapsed_us;
+  uint32_t hundredths = elapsed > 0 ? static_cast<uint32_t>(spent_us * 10000 / elapsed) : 0;
+  Serial.printf("OK: Checkpoints %lu written in %lu us, %lu.%02lu%% of print time, interval %lu ms\n",
+                (unsigned long)writes, (unsigned long)spent_us, (unsigned long)(hundredths / 100),
+                (unsigned long)(hundredths % 100), (unsigned long)interval_ms);
+}
+
+const char *checkpointMessage(CheckpointResult result) {
+  switch (result) {
+    case CheckpointResult::OK: return "Resumed";
+    case CheckpointResult::NONE: return "No print to resume";
+    case CheckpointResult::STALE: return "File changed since checkpoint";
+    case CheckpointResult::APPROACH_FAILED: return "Resume approach failed";
+    default: return "Checkpoint seek failed";
+  }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include "../config.h"
+#include "gcode_parser.h"
+#include "motion_queue.h"
+
+// Points de reprise d'une impression SD, pour repartir après une coupure de courant.
+//
+// sdTask capture entre deux lignes la position dans le fichier, l'état modal et les
+// consignes de chauffe. Une capture n'est écrite qu'une fois tous les mouvements qui la
+// précèdent retirés de motionQueue par son consommateur : la position enregistrée est
+// celle du dernier mouvement exécuté, pas celle du parser qui a de l'avance.
+//
+// Chaque enregistrement occupe un secteur de CHECKPOINT_FILE, fichier contigu réservé
+// au démarrage et écrit secteur par secteur sans passer par le FAT. Les secteurs sont
+// utilisés à tour de rôle ; au démarrage, le plus récent dont le CRC est valide l'emporte,
+// si bien qu'une écriture interrompue par la coupure laisse le précédent intact.
+#define CHECKPOINT_MAGIC 0x50434B43UL // "CKCP"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_SECTOR_BYTES 512
+
+enum CheckpointState : uint8_t {
+  CHECKPOINT_IDLE = 0,         // Aucune impression à reprendre
+  CHECKPOINT_ACTIVE = 1
+};
+
+struct PrintCheckpointRecord {
+  uint32_t magic;
+  uint32_t sequence;           // Croissant, l'emplacement vaut sequence % CHECKPOINT_SLOTS
+  uint16_t version;
+  uint8_t state;
+  uint8_t reserved;
+  uint32_t source_size;        // Taille et date FAT du G-code : point périmé sinon
+  uint16_t source_date, source_time;
+  uint32_t line_number;        // Lignes exécutées
+  uint32_t offset;             // Début de la ligne suivante
+  ModalState modal;
+  ThermalState thermal;
+  char filename[CHECKPOINT_NAME_BYTES];
+  uint32_t crc;                // CRC32 des champs précédents
+};
+
+enum class CheckpointResult : uint8_t {
+  OK, NONE, STALE, READ_ERROR, APPROACH_FAILED
+};
+
+class PrintCheckpoint {
+private:
+  struct Capture {
+    uint32_t motion_sent;      // motionQueue.sentCount() lors de la capture
+    uint32_t line_number, offset;
+    ModalState modal;
+    ThermalState thermal;
+    uint8_t state;
+  };
+
+  PrintCheckpointRecord last;  // Dernier enregistrement écrit (ou retrouvé par init)
+  PrintCheckpointRecord current; // Fichier en cours : nom, taille et date
+  Capture pending[CHECKPOINT_PENDING];
+  uint8_t pending_count;
+  uint32_t first_sector;       // Premier secteur de CHECKPOINT_FILE, 0 si indisponible
+  bool tracking;               // Impression en cours depuis begin()
+  uint32_t interval_ms;
+  uint32_t last_capture_ms;
+  uint32_t writes;
+  int64_t started_us, spent_us, elapsed_us;
+
+  void push(const Capture &capture);
+  bool write(const Capture &capture);
+  void persistExecuted();
+
+public:
+  PrintCheckpoint() : pending_count(0), first_sector(0), tracking(false), interval_ms(CHECKPOINT_INTERVAL_MS),
+                      last_capture_ms(0), writes(0), started_us(0), spent_us(0), elapsed_us(0) {
+    memset(&last, 0, sizeof(last));
+    memset(&current, 0, sizeof(current));
+  }
+  bool init();                 // Réserve CHECKPOINT_FILE et relit le dernier enregistrement
+  bool isReady() const { return first_sector != 0; }
+
+  // sdTask, verrou du parser pris : source placée à offset après line_number lignes
+  void begin(File32 &source, const String &filename, uint32_t line_number, uint32_t offset);
+  bool due() const {
+    return tracking && pending_count < CHECKPOINT_PENDING && millis() - last_capture_ms >= interval_ms;
+  }
+  void capture(uint32_t line_number, uint32_t offset); // Verrou du parser pris
+  void finish();               // Fin de fichier, verrou du parser pris
+  // Écrit la capture exécutée la plus récente ; sdTask, sans le verrou du parser
+  void persist() {
+    if (pending_count && static_cast<int32_t>(motionQueue.receivedCount() - pending[0].motion_sent) >= 0) {
+      persistExecuted();
+    }
+  }
+  bool hasPending() const { return pending_count != 0; }
+
+  bool resumableFile(String &filename) const;
+  // Replace source, rejoue chauffe et approche puis restaure l'état modal ; verrou pris.
+  // Le dégagement en Z est relatif à la hauteur d'arrêt, seule connue après la coupure :
+  // l'approche monte de CHECKPOINT_RESUME_LIFT_MM, fait le homing XY, revient en XY puis
+  // redescend à cette hauteur avant que l'état modal sauvegardé ne reprenne la main.
+  CheckpointResult restore(File32 &source, uint32_t &line_number, uint32_t &offset);
+  void printStats();
+};
+
+const char *checkpointMessage(CheckpointResult result);
+
+extern PrintCheckpoint printCheckpoint;
@@ -0,0 +1,315 @@
+#include "sd_directory.h"
+#include <stdlib.h>
+#include <esp_heap_caps.h>
+#include "../debug_manager.h"
+
+extern SdFat SD;
+extern SemaphoreHandle_t errorSemaphore;
+
+SdDirectoryCache sdDirectory;
+
+static const uint32_t NO_ENTRY = 0xFFFFFFFFUL;
+
+// Dossiers d'abord, puis nom sans casse : l'ordre des enfants et de leur recherche
+static int compareKey(bool a_dir, const char *a, bool b_dir, const char *b) {
+  if (a_dir != b_dir) return a_dir ? -1 : 1;
+  return strcasecmp(a, b);
+}
+
+// Extension sans casse : FAT et les autres outils peuvent l'écrire en majuscules
+static bool endsWith(const char *name, const char *suffix) {
+  size_t len = strlen(name), ext = strlen(suffix);
+  return len > ext && strcasecmp(name + len - ext, suffix) == 0;
+}
+
+bool SdDirectoryCache::init() {
+  for (int n = 0; n < 2; n++) {
+    Tree &tree = trees[n];
+    if (!tree.entries) {
+      tree.entries = static_cast<Entry *>(
+          heap_caps_malloc(sizeof(Entry) * SD_DIRECTORY_MAX_ENTRIES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    }
+    if (!tree.names) {
+      tree.names = static_cast<char *>(heap_caps_malloc(SD_DIRECTORY_NAME_POOL_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    }
+    if (!tree.metadata) {
+      tree.metadata = static_cast<GcodeMetadata *>(
+          heap_caps_malloc(sizeof(GcodeMetadata) * SD_DIRECTORY_MAX_METADATA, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    }
+    if (!tree.entries || !tree.names || !tree.metadata) {
+      DEBUG_PRINTF_AUTO("Erreur: PSRAM insuffisante pour le cache de l'arborescence SD");
+      return false;
+    }
+  }
+  if (!mutex) mutex = xSemaphoreCreateMutex();
+  if (!mutex) return false;
+  dirty = true;
+  return true;
+}
+
+bool SdDirectoryCache::append(const char *name, uint8_t flags, uint32_t size, uint16_t date, uint16_t time) {
+  Tree &tree = *target;
+  size_t len = strlen(name) + 1;
+  if (tree.count == SD_DIRECTORY_MAX_ENTRIES || tree.names_used + len > SD_DIRECTORY_NAME_POOL_BYTES) {
+    tree.truncated = true;
+    return false;
+  }
+  memcpy(tree.names + tree.names_used, name, len);
+  Entry &entry = tree.entries[tree.count++];
+  entry.name = tree.names_used;
+  entry.parent = current;
+  entry.first_child = entry.child_count = 0;
+  entry.size = size;
+  entry.date = date;
+  entry.time = time;
+  entry.meta = NO_META;
+  entry.flags = flags;
+  tree.names_used += len;
+  return true;
+}
+
+// Chemin absolu d'une entrée ; false au-delà de SD_DIRECTORY_MAX_DEPTH ou de size
+bool SdDirectoryCache::pathOf(const Tree &tree, uint32_t index, char *out, size_t size) const {
+  uint32_t chain[SD_DIRECTORY_MAX_DEPTH + 1];
+  uint32_t depth = 0;
+  for (uint32_t n = index; n != 0; n = tree.entries[n].parent) {
+    if (depth == SD_DIRECTORY_MAX_DEPTH + 1) return false;
+    chain[depth++] = n;
+  }
+  size_t len = 0;
+  while (depth--) {
+    const char *name = tree.names + tree.entries[chain[depth]].name;
+    size_t name_len = strlen(name);
+    if (len + name_len + 2 > size) return false;
+    out[len++] = '/';
+    memcpy(out + len, name, name_len);
+    len += name_len;
+  }
+  if (len == 0) out[len++] = '/';
+  out[len] = '\0';
+  return true;
+}
+
+// Recherche dichotomique parmi les enfants triés de parent
+uint32_t SdDirectoryCache::find(const Tree &tree, uint32_t parent, const char *name, bool is_dir) const {
+  uint32_t low = tree.entries[parent].first_child;
+  uint32_t high = low + tree.entries[parent].child_count;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    const Entry &entry = tree.entries[mid];
+    int cmp = compareKey(entry.flags & ENTRY_DIR, tree.names + entry.name, is_dir, name);
+    if (cmp == 0) return mid;
+    if (cmp < 0) low = mid + 1;
+    else high = mid;
+  }
+  return NO_ENTRY;
+}
+
+bool SdDirectoryCache::lookup(const Tree &tree, const char *path, uint32_t &index) const {
+  char component[SD_DIRECTORY_PATH_BYTES];
+  index = 0;
+  while (*path) {
+    while (*path == '/') path++;
+    if (!*path) break;
+    size_t len = strcspn(path, "/");
+    if (len >= sizeof(component)) return false;
+    memcpy(component, path, len);
+    component[len] = '\0';
+    path += len;
+    index = find(tree, index, component, true);
+    if (index == NO_ENTRY) return false;
+  }
+  return true;
+}
+
+void SdDirectoryCache::begin() {
+  dirty = false;
+  if (dir) dir.close();
+  building = false;
+  if (!mutex) return;
+  // L'arborescence publiée reste servie : la construction se fait dans l'autre
+  target = published == &trees[0] ? &trees[1] : &trees[0];
+  target->count = target->names_used = target->meta_count = 0;
+  target->truncated = false;
+  current = 0;
+  append("", ENTRY_DIR, 0, 0, 0); // Racine
+  next_dir = 0;
+  phase = Phase::OPEN;
+  started_ms = millis();
+  building = true;
+}
+
+void SdDirectoryCache::step() {
+  // Une écriture pendant la construction la rendrait périmée avant même sa publication
+  if (dirty) begin();
+  for (uint32_t n = 0; n < SD_DIRECTORY_STEP_ENTRIES && building; n++) {
+    switch (phase) {
+      case Phase::OPEN: openNext(); break;
+      case Phase::READ: readNext(); break;
+      case Phase::ATTACH: attachNext(); break;
+    }
+  }
+}
+
+// Dossier suivant du parcours en largeur, ou publication une fois tous lus
+void SdDirectoryCache::openNext() {
+  Tree &tree = *target;
+  while (next_dir < tree.count && !(tree.entries[next_dir].flags & ENTRY_DIR)) next_dir++;
+  if (next_dir == tree.count) {
+    publish();
+    return;
+  }
+  current = next_dir++;
+  char path[SD_DIRECTORY_PATH_BYTES];
+  if (!pathOf(tree, current, path, sizeof(path))) {
+    DEBUG_PRINTF_AUTO("Dossier SD ignoré (profondeur ou chemin trop long): %s", tree.names + tree.entries[current].name);
+    return;
+  }
+  dir = SD.open(path);
+  if (!dir || !dir.isDir()) {
+    if (dir) dir.close();
+    DEBUG_PRINTF_AUTO("Erreur: Impossible d'ouvrir le dossier %s", path);
+    if (current == 0) {
+      Serial.println("ERROR: Failed to open root directory");
+      if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    }
+    return;
+  }
+  tree.entries[current].first_child = tree.count;
+  phase = Phase::READ;
+}
+
+static const char *sort_names; // Noms de l'arborescence triée par qsort, sdTask seule
+
+int SdDirectoryCache::compareEntries(const void *a, const void *b) {
+  const Entry &left = *static_cast<const Entry *>(a);
+  const Entry &right = *static_cast<const Entry *>(b);
+  return compareKey(left.flags & ENTRY_DIR, sort_names + left.name, right.flags & ENTRY_DIR, sort_names + right.name);
+}
+
+void SdDirectoryCache::readNext() {
+  Tree &tree = *target;
+  File32 file;
+  if (!file.openNext(&dir, FILE_READ)) {
+    dir.close();
+    Entry &folder = tree.entries[current];
+    folder.child_count = tree.count - folder.first_child;
+    sort_names = tree.names;
+    qsort(tree.entries + folder.first_child, folder.child_count, sizeof(Entry), compareEntries);
+    cursor = folder.first_child;
+    phase = Phase::ATTACH;
+    return;
+  }
+  char name[SD_DIRECTORY_PATH_BYTES];
+  bool named = file.getName(name, sizeof(name)) > 0;
+  bool hidden = file.isHidden();
+  bool is_dir = file.isDir();
+  uint32_t size = is_dir ? 0 : file.fileSize();
+  uint16_t date = 0, time = 0;
+  file.getModifyDateTime(&date, &time);
+  file.close();
+  if (!named || hidden) return;
+  if (current == 0 && strcasecmp(name, CHECKPOINT_FILE + 1) == 0) return; // Secteurs des points de reprise
+  uint8_t flags = is_dir ? ENTRY_DIR : 0;
+  if (!is_dir && isGcodeSidecar(name)) {
+    if (!endsWith(name, GCODE_META_EXTENSION)) return; // Index : jamais listés
+    flags = ENTRY_META;
+  }
+  append(name, flags, size, date, time);
+}
+
+// Rattache le fichier .meta suivant du dossier à son G-code, puis retire les .meta de la liste
+void SdDirectoryCache::attachNext() {
+  Tree &tree = *target;
+  Entry &folder = tree.entries[current];
+  uint32_t end = folder.first_child + folder.child_count;
+  while (cursor < end && !(tree.entries[cursor].flags & ENTRY_META)) cursor++;
+  if (cursor == end) {
+    // Enfants en fin de tableau : rien au-delà à décaler
+    uint32_t kept = folder.first_child;
+    for (uint32_t n = folder.first_child; n < end; n++) {
+      if (!(tree.entries[n].flags & ENTRY_META)) tree.entries[kept++] = tree.entries[n];
+    }
+    folder.child_count = kept - folder.first_child;
+    tree.count = kept;
+    phase = Phase::OPEN;
+    return;
+  }
+
+  uint32_t sidecar = cursor++;
+  const char *name = tree.names + tree.entries[sidecar].name;
+  char source[SD_DIRECTORY_PATH_BYTES];
+  size_t len = strlen(name) - strlen(GCODE_META_EXTENSION);
+  memcpy(source, name, len);
+  source[len] = '\0';
+  uint32_t gcode = find(tree, current, source, false);
+  char path[SD_DIRECTORY_PATH_BYTES];
+  if (gcode == NO_ENTRY || tree.meta_count == SD_DIRECTORY_MAX_METADATA || !pathOf(tree, sidecar, path, sizeof(path))) {
+    return;
+  }
+  GcodeMetadata &meta = tree.metadata[tree.meta_count];
+  File32 file = SD.open(path, FILE_READ);
+  bool read = file && file.read(&meta, sizeof(meta)) == sizeof(meta);
+  if (file) file.close();
+  Entry &entry = tree.entries[gcode];
+  if (read && isGcodeMetadataValid(meta, entry.size, entry.date, entry.time)) entry.meta = tree.meta_count++;
+}
+
+void SdDirectoryCache::publish() {
+  Tree *built = target;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  published = built;
+  publications++;
+  xSemaphoreGive(mutex);
+  target = NULL;
+  building = false;
+  DEBUG_PRINTF_AUTO("Arborescence SD en cache: %lu entrées, %lu résumés en %lu ms", (unsigned long)built->count - 1,
+                    (unsigned long)built->meta_count, (unsigned long)(millis() - started_ms));
+  if (built->truncated) {
+    DEBUG_PRINTF_AUTO("Erreur: Cache de l'arborescence SD plein, entrées manquantes");
+    Serial.println("ERROR: SD directory cache full, listing truncated");
+  }
+}
+
+SdDirectoryResult SdDirectoryCache::list(const char *path, uint32_t offset, SdDirectoryItem *items, uint32_t capacity,
+                                         uint32_t &copied, uint32_t &total, uint32_t &generation) {
+  copied = total = 0;
+  if (!mutex) return SdDirectoryResult::NOT_READY;
+  SdDirectoryResult result = SdDirectoryResult::OK;
+  // Copie seule sous le verrou : sdTask publie sans attendre l'affichage
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  generation = publications;
+  uint32_t index;
+  if (!published) {
+    result = SdDirectoryResult::NOT_READY;
+  } else if (!lookup(*published, path, index)) {
+    result = SdDirectoryResult::NOT_FOUND;
+  } else {
+    const Tree &tree = *published;
+    const Entry &folder = tree.entries[index];
+    total = folder.child_count;
+    while (copied < capacity && offset + copied < total) {
+      const Entry &entry = tree.entries[folder.first_child + offset + copied];
+      SdDirectoryItem &item = items[copied++];
+      strncpy(item.name, tree.names + entry.name, sizeof(item.name) - 1);
+      item.name[sizeof(item.name) - 1] = '\0';
+      item.is_dir = (entry.flags & ENTRY_DIR) != 0;
+      item.has_meta = entry.meta != NO_META;
+      item.size = entry.size;
+      item.date = entry.date;
+      item.time = entry.time;
+      if (item.has_meta) item.meta = tree.metadata[entry.meta];
+    }
+  }
+  xSemaphoreGive(mutex);
+  return result;
+}
+
+const char *sdDirectoryMessage(SdDirectoryResult result) {
+  switch (result) {
+    case SdDirectoryResult::OK: return "Listed";
+    case SdDirectoryResult::NOT_READY: return "SD listing not ready";
+    case SdDirectoryResult::NOT_FOUND: return "Directory not found";
+  }
+  return "Unknown listing error";
+}
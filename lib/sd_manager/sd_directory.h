@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "../config.h"
+#include "gcode_index.h"
+
+// Arborescence de la carte en cache, pour lister sans accès SD depuis commTask ou l'interface.
+//
+// sdTask parcourt la carte en largeur, par pas de SD_DIRECTORY_STEP_ENTRIES entre deux
+// fichiers joués : les enfants d'un dossier sont contigus, triés (dossiers d'abord, puis
+// nom sans casse), et chaque G-code reçoit le résumé de son fichier .meta s'il est encore
+// valable. L'arborescence terminée est publiée à la place de la précédente, qui reste
+// servie pendant toute la reconstruction.
+//
+// invalidate() demande une reconstruction : appelée par tout ce qui écrit sur la carte.
+// Les fichiers annexes (index, résumés, CHECKPOINT_FILE) ne sont jamais listés.
+
+// Entrée copiée par list() : l'appelant l'affiche une fois le verrou rendu
+struct SdDirectoryItem {
+  char name[SD_DIRECTORY_PATH_BYTES];
+  bool is_dir;
+  bool has_meta;               // false sans résumé valable
+  uint32_t size;
+  uint16_t date, time;         // Date FAT de modification
+  GcodeMetadata meta;
+};
+
+enum class SdDirectoryResult : uint8_t {
+  OK, NOT_READY, NOT_FOUND
+};
+
+class SdDirectoryCache {
+private:
+  enum : uint8_t {
+    ENTRY_DIR = 1 << 0,
+    ENTRY_META = 1 << 1        // Fichier .meta, retiré une fois rattaché à son G-code
+  };
+  static const uint16_t NO_META = 0xFFFF;
+
+  struct Entry {
+    uint32_t name;             // Position dans names
+    uint32_t parent;
+    uint32_t first_child, child_count; // Dossiers
+    uint32_t size;
+    uint16_t date, time;
+    uint16_t meta;             // Indice dans metadata, NO_META sinon
+    uint8_t flags;
+  };
+
+  struct Tree {
+    Entry *entries;
+    char *names;
+    GcodeMetadata *metadata;
+    uint32_t count, names_used, meta_count;
+    bool truncated;            // Capacité atteinte : entrées manquantes
+  };
+
+  enum class Phase : uint8_t {
+    OPEN, READ, ATTACH
+  };
+
+  Tree trees[2];
+  Tree *published;             // Lu sous mutex ; NULL avant la première construction
+  Tree *target;                // En construction par sdTask
+  SemaphoreHandle_t mutex;
+  volatile bool dirty;
+  volatile uint32_t publications;
+  bool building;
+  Phase phase;
+  File32 dir;
+  uint32_t next_dir;           // Parcours en largeur : prochaine entrée à examiner
+  uint32_t current;            // Dossier en cours de lecture
+  uint32_t cursor;             // Phase ATTACH : prochaine entrée du dossier
+  uint32_t started_ms;
+
+  bool append(const char *name, uint8_t flags, uint32_t size, uint16_t date, uint16_t time);
+  bool pathOf(const Tree &tree, uint32_t index, char *out, size_t size) const;
+  uint32_t find(const Tree &tree, uint32_t parent, const char *name, bool is_dir) const;
+  bool lookup(const Tree &tree, const char *path, uint32_t &index) const;
+  void begin();
+  void openNext();
+  void readNext();
+  void attachNext();
+  void publish();
+  static int compareEntries(const void *a, const void *b); // qsort
+
+public:
+  SdDirectoryCache() : published(NULL), target(NULL), mutex(NULL), dirty(false), publications(0), building(false),
+                       phase(Phase::OPEN), next_dir(0), current(0), cursor(0), started_ms(0) {
+    memset(trees, 0, sizeof(trees));
+  }
+  bool init();                 // Deux arborescences en PSRAM ; la première construction est demandée
+  void invalidate() { dirty = true; }
+  bool needsWork() const { return dirty || building; }
+  void step();                 // sdTask, entre deux fichiers
+  uint32_t generation() const { return publications; } // Change à chaque publication
+
+  // Copie dans items au plus capacity entrées du dossier path à partir de offset. total
+  // reçoit le nombre d'entrées du dossier et generation l'exemplaire lu : une page lue en
+  // plusieurs appels n'est cohérente que si generation ne change pas.
+  SdDirectoryResult list(const char *path, uint32_t offset, SdDirectoryItem *items, uint32_t capacity,
+                         uint32_t &copied, uint32_t &total, uint32_t &generation);
+};
+
+const char *sdDirectoryMessage(SdDirectoryResult result);
+
+extern SdDirectoryCache sdDirectory;
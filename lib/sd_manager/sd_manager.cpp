@@ -6,6 +6,14 @@
 #include <freertos/queue.h>
 #include "../debug_manager.h"
 #include "system_manager.h"
+#include "../gcode_parser/gcode_parser.h"
+#include "../gcode_parser/gcode_binary.h"
+#include "../gcode_parser/gcode_preparse.h"
+#include "sd_read_ahead.h"
+#include "gcode_index.h"
+#include "print_checkpoint.h"
+#include "sd_directory.h"
+#include <esp_heap_caps.h>
 
 extern QueueHandle_t sdQueue;
 extern QueueHandle_t gcodeQueue;
@@ -14,56 +22,371 @@ extern SemaphoreHandle_t errorSemaphore;
 SdFat SD;
 SDManager sdManager;
 
-void SDManager::sdTask(void *pvParameters) {
-  String filename;
+// G-code binaire (.gcb) : les enregistrements sont décodés puis transmis directement
+// à processWords, sans passer par gcodeQueue ni par le découpage texte
+static void playBinaryFile(File32 &file, uint32_t command_count) {
+  uint8_t buffer[512];
+  size_t len = 0, pos = 0;
+  uint32_t commands = 0;
+  uint32_t offset = GCODE_BINARY_HEADER_SIZE; // Position dans le fichier de buffer[pos]
+  GcodeBinaryState state;
+  state.reset();
+
+  while (!parseErrors.isAborted()) {
+    // Recharge dès qu'un enregistrement complet n'est plus garanti dans le tampon
+    if (len - pos < GCODE_BINARY_MAX_RECORD && file.available()) {
+      memmove(buffer, buffer + pos, len - pos);
+      len -= pos;
+      pos = 0;
+      int bytesRead = file.read(buffer + len, sizeof(buffer) - len);
+      if (bytesRead > 0) len += bytesRead;
+    }
+    if (pos == len) break;
+
+    TokenizedLine words;
+    int used = decodeGcodeRecord(buffer + pos, len - pos, state, words);
+    commands++;
+    if (used <= 0) {
+      // Les deltas rendent la suite illisible : arrêt quelle que soit la politique
+      gcodeParser.lock();
+      gcodeParser.recordError(ParseErrorCode::CORRUPTED_RECORD, 0, commands, offset);
+      gcodeParser.unlock();
+      break;
+    }
+
+    MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+    gcodeParser.lock();
+    ParseStatus status = gcodeParser.processWords(words, cmd);
+    if (status == ParseStatus::OK) gcodeParser.emitCommand(cmd);
+    ParseErrorCode error = gcodeParser.errorCode(status);
+    if (error != ParseErrorCode::NONE) gcodeParser.recordError(error, 0, commands, offset);
+    gcodeParser.unlock();
+    pos += used;
+    offset += used;
+  }
+  gcodeParser.lock();
+  gcodeParser.flushMotion();
+  gcodeParser.summarizeErrors();
+  gcodeParser.unlock();
+  if (!parseErrors.isAborted() && parseErrors.count() == 0 && commands != command_count) {
+    DEBUG_PRINTF_AUTO("Erreur: %lu commandes lues, %lu annoncées", (unsigned long)commands, (unsigned long)command_count);
+    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    Serial.println("ERROR: Truncated binary G-code");
+  }
+}
+
+#if SD_FUSED_PARSE
+// G-code texte en mode fusionné : les lignes sont découpées en place dans les blocs de
+// lecture anticipée et parsées par sdTask ; seules les MotionCommand quittent la tâche.
+// file est placé à offset, après line_number lignes (0 et 0 depuis le début).
+static void playTextFile(File32 &file, uint32_t line_number, uint32_t offset) {
+  bool eof = false;
+  sdReadAhead.begin(file);
+
+  while (!parseErrors.isAborted()) {
+    size_t len;
+    const char *start = sdReadAhead.data(len);
+    const char *newline = len ? static_cast<const char *>(memchr(start, '\n', len)) : NULL;
+    if (!newline && !eof && len < SD_READ_BUFFER_BYTES) {
+      if (!sdReadAhead.refill()) eof = true; // Ligne incomplète : bloc suivant
+      continue;
+    }
+    if (len == 0) break;
+    // Sans '\n' : fin de fichier, ou ligne plus longue que SD_READ_BUFFER_BYTES prise telle quelle
+    size_t line_len = newline ? newline - start : (len < SD_READ_BUFFER_BYTES ? len : SD_READ_BUFFER_BYTES);
+    line_number++;
+
+    MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+    gcodeParser.lock();
+    if (printCheckpoint.due()) printCheckpoint.capture(line_number - 1, offset);
+    ParseStatus status = gcodeParser.parseLine(start, line_len, cmd);
+    if (status == ParseStatus::OK) gcodeParser.emitCommand(cmd);
+    ParseErrorCode error = gcodeParser.errorCode(status);
+    if (error != ParseErrorCode::NONE) {
+      gcodeParser.recordError(error, gcodeParser.errorColumn(), line_number, offset);
+    }
+    gcodeParser.unlock();
+    printCheckpoint.persist();
+
+    size_t used = newline ? line_len + 1 : line_len;
+    sdReadAhead.consume(used);
+    offset += used;
+  }
+  sdReadAhead.end();
+  gcodeParser.lock();
+  gcodeParser.flushMotion();
+  gcodeParser.summarizeErrors();
+  printCheckpoint.finish();
+  gcodeParser.unlock();
+}
+#endif
+
+#if SD_FUSED_PARSE && SD_PARALLEL_PARSE
+static PreparseBuffer preparse;
+static TaskHandle_t preparseTaskHandle = NULL; // Défini une fois les blocs alloués
+static TaskHandle_t consumerTaskHandle = NULL;
+// Fichier confié par sdTask à PreparseTask. Une queue plutôt qu'une notification : celles
+// de PreparseTask signalent déjà les blocs libérés.
+struct PreparseJob {
+  File32 *file;
+  uint32_t line_number, offset; // Point de départ, comme pour playTextFile
+};
+static QueueHandle_t preparseQueue = NULL;
+
+// Cœur 0 : lecture SD et tokenisation des blocs, en avance sur sdTask
+void SDManager::preparseTask(void *pvParameters) {
+  PreparsedChunk *storage = static_cast<PreparsedChunk *>(
+      heap_caps_malloc(sizeof(PreparsedChunk) * PREPARSE_SLOTS, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+  if (!storage) storage = static_cast<PreparsedChunk *>(heap_caps_malloc(sizeof(PreparsedChunk) * PREPARSE_SLOTS, MALLOC_CAP_8BIT));
+  if (!storage) {
+    DEBUG_PRINTF_AUTO("Erreur: Allocation des blocs de pré-découpage impossible, lecture sur un seul cœur");
+    vTaskDelete(NULL);
+    return;
+  }
+  preparseQueue = xQueueCreate(1, sizeof(PreparseJob));
+  if (!preparseQueue) {
+    DEBUG_PRINTF_AUTO("Erreur: Impossible de créer preparseQueue, lecture sur un seul cœur");
+    vTaskDelete(NULL);
+    return;
+  }
+  preparse.attach(storage, PREPARSE_SLOTS);
+  preparseTaskHandle = xTaskGetCurrentTaskHandle();
+
+  PreparseJob job;
   while (1) {
-    if (xQueueReceive(sdQueue, &filename, portMAX_DELAY) == pdTRUE) {
-      xQueueReset(gcodeQueue);
-      DEBUG_PRINTF_AUTO("gcodeQueue vidée avant lecture de %s", filename.c_str());
-
-      File32 file = SD.open(filename.c_str(), FILE_READ);
-      if (file) {
-        DEBUG_PRINTF_AUTO("Lecture du fichier %s", filename.c_str());
-        char buffer[512];
-        while (file.available()) {
-          int bytesRead = file.readBytesUntil('\n', buffer, sizeof(buffer) - 1);
-          buffer[bytesRead] = '\0';
-          String line = String(buffer);
-          line.trim();
-          if (line.isEmpty()) {
-            DEBUG_PRINTF_AUTO("Debug: Ligne vide ignorée");
-            continue;
-          }
-          if (line.startsWith(";")) {
-            DEBUG_PRINTF_AUTO("Debug: Ignored line: '%s'", line.c_str());
-            continue;
-          }
-          int commentPos = line.indexOf(';');
-          if (commentPos != -1) {
-            line = line.substring(0, commentPos);
-            line.trim();
-          }
-          if (line.isEmpty()) {
-            DEBUG_PRINTF_AUTO("Debug: Ligne vide après suppression du commentaire");
-            continue;
-          }
-          DEBUG_PRINTF_AUTO("Debug: Envoi ligne à gcodeQueue: '%s'", line.c_str());
-          if (xQueueSend(gcodeQueue, &line, pdMS_TO_TICKS(5000)) != pdTRUE) {
-            DEBUG_PRINTF_AUTO("Erreur: Impossible d'envoyer à gcodeQueue après 5s");
-            if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-            Serial.println("ERROR: Failed to send to gcodeQueue");
-          }
-          vTaskDelay(pdMS_TO_TICKS(10));
+    xQueueReceive(preparseQueue, &job, portMAX_DELAY);
+    sdReadAhead.begin(*job.file);
+    uint32_t line_number = job.line_number, offset = job.offset, sequence = 0;
+    bool eof = false, last = false;
+    while (!last) {
+      PreparsedChunk *chunk;
+      while (!(chunk = preparse.acquire(sequence))) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+      while (chunk->count < PREPARSE_CHUNK_LINES && !parseErrors.isAborted()) {
+        size_t len;
+        const char *data = sdReadAhead.data(len);
+        sdReadAhead.consume(preparseLines(data, len, eof, line_number, offset, *chunk));
+        if (chunk->count == PREPARSE_CHUNK_LINES || eof) break;
+        // Reste une ligne incomplète : prise telle quelle si elle ne tient pas dans la
+        // marge de refill(), sinon complétée par le bloc suivant
+        data = sdReadAhead.data(len);
+        if (len >= SD_READ_BUFFER_BYTES) {
+          sdReadAhead.consume(preparseLines(data, SD_READ_BUFFER_BYTES, true, line_number, offset, *chunk));
+          continue;
         }
+        if (!sdReadAhead.refill()) eof = true;
+      }
+      last = (eof && sdReadAhead.available() == 0) || parseErrors.isAborted();
+      chunk->last = last;
+      if (last) sdReadAhead.end(); // ReadAheadTask lâche le fichier avant que sdTask le ferme
+      preparse.publish(chunk);
+      xTaskNotifyGive(consumerTaskHandle);
+      sequence++;
+    }
+  }
+}
+
+// Passe séquentielle sur le cœur 1 : état modal, variables et sous-programmes, dans
+// l'ordre des blocs. Le fichier reste ouvert jusqu'au dernier bloc.
+static void playTextFileParallel(File32 &file, uint32_t line_number, uint32_t offset) {
+  preparse.reset();
+  consumerTaskHandle = xTaskGetCurrentTaskHandle();
+  PreparseJob job = {&file, line_number, offset};
+  xQueueSend(preparseQueue, &job, portMAX_DELAY);
+
+  uint32_t sequence = 0;
+  bool last = false;
+  while (!last) {
+    PreparsedChunk *chunk = preparse.peek(sequence);
+    if (!chunk) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+      continue;
+    }
+    for (uint16_t n = 0; n < chunk->count && !parseErrors.isAborted(); n++) {
+      const PreparsedLine &line = chunk->lines[n];
+      MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+      gcodeParser.lock();
+      if (printCheckpoint.due()) printCheckpoint.capture(line.line - 1, line.offset);
+      ParseErrorCode error = static_cast<ParseErrorCode>(line.status);
+      uint16_t column = line.column;
+      if (line.status == TokenStatus::OK) {
+        ParseStatus status = gcodeParser.processWords(line.words, cmd);
+        if (status == ParseStatus::OK) gcodeParser.emitCommand(cmd);
+        error = gcodeParser.errorCode(status);
+        column = gcodeParser.errorColumn();
+      }
+      if (error != ParseErrorCode::NONE) gcodeParser.recordError(error, column, line.line, line.offset);
+      gcodeParser.unlock();
+      printCheckpoint.persist();
+    }
+    last = chunk->last;
+    preparse.release(sequence++);
+    xTaskNotifyGive(preparseTaskHandle);
+  }
+  gcodeParser.lock();
+  gcodeParser.flushMotion();
+  gcodeParser.summarizeErrors();
+  printCheckpoint.finish();
+  gcodeParser.unlock();
+}
+#endif
+
+// Fichier demandé par sdQueue, depuis le début ou depuis une couche ou une ligne indexée
+static void playFile(const String &filename, SdRequest kind, int32_t start) {
+  clearGcodeQueue();
+  DEBUG_PRINTF_AUTO("gcodeQueue vidée avant lecture de %s", filename.c_str());
+  // Sous-programmes, variables, erreurs et mouvement retenu par la fusion ne survivent
+  // pas au fichier qui les définit
+  gcodeParser.lock();
+  gcodeParser.resetProgram();
+  parseErrors.reset();
+  gcodeParser.discardMotion();
+  gcodeParser.unlock();
+
+  File32 file = SD.open(filename.c_str(), FILE_READ);
+  uint8_t header[GCODE_BINARY_HEADER_SIZE];
+  uint32_t command_count;
+  bool binary = file && file.read(header, sizeof(header)) == sizeof(header) &&
+                readGcodeBinaryHeader(header, sizeof(header), command_count);
+  if (binary && kind != SdRequest::PLAY) {
+    file.close();
+    DEBUG_PRINTF_AUTO("Erreur: Départ en cours de fichier impossible pour le binaire %s", filename.c_str());
+    Serial.println("ERROR: Seek requires a text G-code file");
+  } else if (binary) {
+    DEBUG_PRINTF_AUTO("Lecture du fichier binaire %s (%lu commandes)", filename.c_str(), (unsigned long)command_count);
+    playBinaryFile(file, command_count);
+    file.close();
+    DEBUG_PRINTF_AUTO("Fin de lecture de %s", filename.c_str());
+  } else if (file && filename.endsWith(GCODE_BINARY_EXTENSION)) {
+    file.close();
+    DEBUG_PRINTF_AUTO("Erreur: En-tête binaire invalide pour %s", filename.c_str());
+    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    Serial.println("ERROR: Invalid binary G-code header");
+  } else if (file) {
+    file.seekSet(0);
+    uint32_t line_number = 0, offset = 0; // Lignes déjà passées, position de départ
+    if (kind == SdRequest::RESUME) {
+      gcodeParser.lock();
+      CheckpointResult resumed = printCheckpoint.restore(file, line_number, offset);
+      gcodeParser.unlock();
+      if (resumed != CheckpointResult::OK) {
+        file.close();
+        DEBUG_PRINTF_AUTO("Erreur: Reprise de %s impossible (%s)", filename.c_str(), checkpointMessage(resumed));
+        Serial.printf("ERROR: %s\n", checkpointMessage(resumed));
+        return;
+      }
+      Serial.printf("OK: Resuming %s at line %lu\n", filename.c_str(), (unsigned long)line_number + 1);
+    } else if (kind != SdRequest::PLAY) {
+      gcodeParser.lock();
+      ModalState saved = gcodeParser.modalState();
+      GcodeSeekResult seek = seekGcodeFile(file, filename, kind == SdRequest::PLAY_FROM_LAYER, start,
+                                           line_number, offset);
+      if (seek != GcodeSeekResult::OK) gcodeParser.restoreModalState(saved);
+      gcodeParser.unlock();
+      if (seek != GcodeSeekResult::OK) {
         file.close();
-        DEBUG_PRINTF_AUTO("Fin de lecture de %s", filename.c_str());
-      } else {
-        DEBUG_PRINTF_AUTO("Erreur: Impossible d'ouvrir %s", filename.c_str());
+        DEBUG_PRINTF_AUTO("Erreur: Départ de %s en %s %ld impossible (%s)", filename.c_str(),
+                          kind == SdRequest::PLAY_FROM_LAYER ? "couche" : "ligne", (long)start,
+                          gcodeSeekMessage(seek));
+        Serial.printf("ERROR: %s\n", gcodeSeekMessage(seek));
+        return;
+      }
+      line_number--; // La ligne atteinte est la prochaine lue
+    }
+    DEBUG_PRINTF_AUTO("Lecture du fichier %s depuis la ligne %lu", filename.c_str(), (unsigned long)line_number + 1);
+#if SD_FUSED_PARSE
+    gcodeParser.lock();
+    printCheckpoint.begin(file, filename, line_number, offset);
+    gcodeParser.unlock();
+#endif
+#if SD_FUSED_PARSE && SD_PARALLEL_PARSE
+    if (preparseTaskHandle) playTextFileParallel(file, line_number, offset);
+    else playTextFile(file, line_number, offset);
+    file.close();
+#elif SD_FUSED_PARSE
+    playTextFile(file, line_number, offset);
+    file.close();
+#else
+    // Chaque ligne est lue directement dans un slab qui part tel quel vers parserTask ;
+    // un slab refusé ou sans commande sert à la ligne suivante
+    LineSlab *slab = NULL;
+    while (file.available() && !parseErrors.isAborted()) {
+      if (!slab && !(slab = linePool.acquire(pdMS_TO_TICKS(5000)))) {
+        DEBUG_PRINTF_AUTO("Erreur: Pool de lignes épuisé après 5s");
+        if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+        Serial.println("ERROR: Line pool exhausted");
+        break;
+      }
+      slab->offset = file.curPosition();
+      slab->line_number = ++line_number;
+      slab->length = file.readBytesUntil('\n', slab->text, LINE_SLAB_BYTES - 1);
+      slab->text[slab->length] = '\0';
+      char *comment = static_cast<char *>(memchr(slab->text, ';', slab->length));
+      if (comment) {
+        *comment = '\0';
+        slab->length = comment - slab->text;
+      }
+      slab->trim();
+      if (slab->length == 0) {
+        DEBUG_PRINTF_AUTO("Debug: Ligne vide ou commentaire ignoré");
+        continue;
+      }
+      DEBUG_PRINTF_AUTO("Debug: Envoi ligne à gcodeQueue: '%s'", slab->text);
+      if (!sendGcodeLine(slab, pdMS_TO_TICKS(5000))) {
+        DEBUG_PRINTF_AUTO("Erreur: Impossible d'envoyer à gcodeQueue après 5s");
         if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-        Serial.println("ERROR: Failed to open file");
+        Serial.println("ERROR: Failed to send to gcodeQueue");
+        continue;
       }
+      slab = NULL; // Propriété transférée à parserTask
+    }
+    file.close();
+    // parserTask publie le résumé des erreurs après la dernière ligne
+    if (!slab) slab = linePool.acquire(portMAX_DELAY);
+    slab->line_number = line_number;
+    slab->offset = 0;
+    slab->length = 0;
+    slab->text[0] = '\0';
+    slab->end_of_file = true;
+    if (!sendGcodeLine(slab, portMAX_DELAY)) linePool.recycle(slab);
+#endif
+    DEBUG_PRINTF_AUTO("Fin de lecture de %s", filename.c_str());
+  } else {
+    DEBUG_PRINTF_AUTO("Erreur: Impossible d'ouvrir %s", filename.c_str());
+    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    Serial.println("ERROR: Failed to open file");
+  }
+}
+
+void SDManager::sdTask(void *pvParameters) {
+  LineSlab *request;
+  while (1) {
+    // Entre deux fichiers, l'index en construction avance d'un pas à chaque tick et le
+    // dernier point de reprise attend l'exécution des derniers mouvements
+    bool background = gcodeIndexer.isBuilding() || printCheckpoint.hasPending() || sdDirectory.needsWork();
+    if (xQueueReceive(sdQueue, &request, background ? 1 : portMAX_DELAY) != pdTRUE) {
+      printCheckpoint.persist();
+      // L'arborescence attend la fin de l'index, qui la rendrait aussitôt périmée
+      if (gcodeIndexer.isBuilding()) gcodeIndexer.step();
+      else sdDirectory.step();
+      continue;
+    }
+    String filename(request->text);
+    SdRequest kind = static_cast<SdRequest>(request->offset);
+    int32_t start = static_cast<int32_t>(request->line_number);
+    linePool.recycle(request);
+    if (kind == SdRequest::INDEX) {
+      gcodeIndexer.request(filename);
+    } else if (kind == SdRequest::SCAN) {
+      if (filename.isEmpty()) gcodeIndexer.scanAll();
+      else gcodeIndexer.request(filename, false);
+    } else if (kind == SdRequest::REFRESH) {
+      sdDirectory.invalidate();
+    } else if (kind == SdRequest::RESUME && !printCheckpoint.resumableFile(filename)) {
+      DEBUG_PRINTF_AUTO("Erreur: Aucune impression à reprendre");
+      Serial.printf("ERROR: %s\n", checkpointMessage(CheckpointResult::NONE));
+    } else {
+      playFile(filename, kind, start);
     }
-    vTaskDelay(pdMS_TO_TICKS(100));
   }
 }
 
@@ -75,22 +398,75 @@ bool SDManager::init() {
     return false;
   }
   DEBUG_PRINTF_AUTO("Carte SD initialisée");
+#if SD_FUSED_PARSE
+  if (!sdReadAhead.init()) {
+    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    Serial.println("ERROR: SD read-ahead initialization failed");
+    return false;
+  }
+  // Sans secteurs réservés, l'impression se poursuit sans points de reprise
+  printCheckpoint.init();
+#endif
+  // Sans PSRAM, LIST_SD répond "not ready" ; la lecture des fichiers n'en dépend pas
+  sdDirectory.init();
   return true;
 }
 
-void SDManager::readFile(String filename) {
+// Débit du dernier fichier texte : de bout en bout (lecture et parsing) et carte seule
+void SDManager::printReadStats() {
+#if SD_FUSED_PARSE
+  DEBUG_PRINTF_AUTO("Dernière lecture: %lu octets en %lu ms", (unsigned long)sdReadAhead.lastBytes(),
+                    (unsigned long)sdReadAhead.lastMillis());
+  Serial.printf("OK: SD read %lu bytes in %lu ms, %lu B/s sustained, %lu B/s card\n",
+                (unsigned long)sdReadAhead.lastBytes(), (unsigned long)sdReadAhead.lastMillis(),
+                (unsigned long)sdReadAhead.pipelineBytesPerSecond(), (unsigned long)sdReadAhead.cardBytesPerSecond());
+  printCheckpoint.printStats();
+#else
+  Serial.println("ERROR: SD statistics require SD_FUSED_PARSE");
+#endif
+}
+
+bool SDManager::sendRequest(String filename, SdRequest kind, int32_t start) {
   filename.trim();
-  if (filename.isEmpty()) {
+  if (filename.isEmpty() && kind != SdRequest::RESUME && kind != SdRequest::SCAN && kind != SdRequest::REFRESH) {
     DEBUG_PRINTF_AUTO("Erreur: Nom de fichier vide");
     Serial.println("ERROR: Empty filename");
     if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-    return;
+    return false;
   }
-  if (xQueueSend(sdQueue, &filename, pdMS_TO_TICKS(100)) != pdTRUE) {
-    DEBUG_PRINTF_AUTO("Erreur: Impossible d'envoyer filename à sdQueue");
-    Serial.println("ERROR: Failed to send to sdQueue");
-    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+  // Le nom voyage dans un slab : sdQueue ne contient que des pointeurs
+  LineSlab *slab = linePool.acquire(pdMS_TO_TICKS(100));
+  if (slab) {
+    slab->set(filename.c_str(), filename.length());
+    slab->line_number = static_cast<uint32_t>(start);
+    slab->offset = static_cast<uint32_t>(kind);
+    if (xQueueSend(sdQueue, &slab, pdMS_TO_TICKS(100)) == pdTRUE) return true;
+    linePool.recycle(slab);
   }
+  DEBUG_PRINTF_AUTO("Erreur: Impossible d'envoyer filename à sdQueue");
+  Serial.println("ERROR: Failed to send to sdQueue");
+  if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+  return false;
+}
+
+void SDManager::readFile(String filename) {
+  sendRequest(filename, SdRequest::PLAY, 0);
+}
+
+void SDManager::readFileFrom(String filename, bool by_layer, int32_t start) {
+  sendRequest(filename, by_layer ? SdRequest::PLAY_FROM_LAYER : SdRequest::PLAY_FROM_LINE, start);
+}
+
+void SDManager::indexFile(String filename) {
+  sendRequest(filename, SdRequest::INDEX, 0);
+}
+
+void SDManager::scanFile(String filename) {
+  sendRequest(filename, SdRequest::SCAN, 0);
+}
+
+void SDManager::resume() {
+  sendRequest(String(), SdRequest::RESUME, 0); // Fichier lu dans le point de reprise
 }
 
 void SDManager::testReadSD(String filename) {
@@ -136,33 +512,68 @@ void SDManager::testReadSD(String filename) {
   }
 }
 
-void SDManager::listFiles() {
-  File32 dir = SD.open("/");
-  if (!dir) {
-    DEBUG_PRINTF_AUTO("Erreur: Impossible d'ouvrir le répertoire racine");
-    Serial.println("ERROR: Failed to open root directory");
-    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+// Ligne Info: d'un fichier listé : taille, date FAT et résumé en cache s'il existe
+static void printListEntry(const SdDirectoryItem &item) {
+  if (item.is_dir) {
+    Serial.printf("Dir: %s/\n", item.name);
     return;
   }
-  DEBUG_PRINTF_AUTO("Liste des fichiers sur la carte SD:");
-  Serial.println("Files on SD card:");
-  bool foundFiles = false;
-  char fileName[256]; // Buffer pour stocker le nom du fichier
-  File32 file;
-  while (file.openNext(&dir, FILE_READ)) {
-    if (!file.isDir()) {
-      file.getName(fileName, sizeof(fileName));
-      DEBUG_PRINTF_AUTO("Fichier: %s", fileName);
-      Serial.print("File: ");
-      Serial.println(fileName);
-      foundFiles = true;
+  Serial.print("File: ");
+  Serial.println(item.name);
+  char info[224];
+  int len = snprintf(info, sizeof(info), "size=%lu modified=%04u-%02u-%02uT%02u:%02u:%02u", (unsigned long)item.size,
+                     (unsigned)((item.date >> 9) + 1980), (unsigned)((item.date >> 5) & 0x0F), (unsigned)(item.date & 0x1F),
+                     (unsigned)(item.time >> 11), (unsigned)((item.time >> 5) & 0x3F), (unsigned)((item.time & 0x1F) * 2));
+  if (item.has_meta && len > 0 && static_cast<size_t>(len) < sizeof(info) - 1) {
+    info[len++] = ' ';
+    formatGcodeMetadata(item.meta, info + len, sizeof(info) - len);
+  }
+  Serial.printf("Info: %s %s\n", item.name, info);
+}
+
+static SdDirectoryItem listBatch[SD_DIRECTORY_LIST_BATCH]; // commTask seule
+
+// Page lue dans l'arborescence en cache : aucun accès à la carte depuis commTask. Les
+// entrées sont copiées par lots sous le verrou et affichées après l'avoir rendu.
+void SDManager::listFiles(String path, uint32_t offset, uint32_t count) {
+  path.trim();
+  if (path.isEmpty()) path = "/";
+  Serial.printf("Files on SD card: %s\n", path.c_str());
+  uint32_t total = 0, shown = 0, generation = 0;
+  while (true) {
+    uint32_t wanted = count - shown < SD_DIRECTORY_LIST_BATCH ? count - shown : SD_DIRECTORY_LIST_BATCH;
+    uint32_t copied, batch_total, batch_generation;
+    SdDirectoryResult result = sdDirectory.list(path.c_str(), offset + shown, listBatch, wanted, copied, batch_total,
+                                                batch_generation);
+    if (result != SdDirectoryResult::OK) {
+      DEBUG_PRINTF_AUTO("Erreur: Liste de %s impossible (%s)", path.c_str(), sdDirectoryMessage(result));
+      Serial.printf("ERROR: %s\n", sdDirectoryMessage(result));
+      return;
     }
-    file.close();
+    if (shown == 0) {
+      total = batch_total;
+      generation = batch_generation;
+    } else if (batch_generation != generation) {
+      // Arborescence republiée entre deux lots : la suite de la page ne correspond plus
+      DEBUG_PRINTF_AUTO("Erreur: Arborescence de %s modifiée pendant la liste", path.c_str());
+      Serial.println("ERROR: SD listing changed, retry");
+      return;
+    }
+    for (uint32_t n = 0; n < copied; n++) printListEntry(listBatch[n]);
+    shown += copied;
+    if (copied < wanted || shown == count) break;
   }
-  dir.close();
-  if (!foundFiles) {
-    DEBUG_PRINTF_AUTO("Aucun fichier trouvé sur la carte SD");
+  if (total == 0) {
+    DEBUG_PRINTF_AUTO("Aucun fichier trouvé dans %s", path.c_str());
     Serial.println("No files found on SD card");
   }
+  // Curseur : next donne l'offset de la page suivante, absent sur la dernière
+  Serial.printf("Page: offset=%lu count=%lu total=%lu", (unsigned long)offset, (unsigned long)shown, (unsigned long)total);
+  if (offset + shown < total) Serial.printf(" next=%lu", (unsigned long)(offset + shown));
+  Serial.println();
   Serial.println("OK: File list completed");
+}
+
+void SDManager::refreshFiles() {
+  sendRequest(String(), SdRequest::REFRESH, 0);
 }
\ No newline at end of file
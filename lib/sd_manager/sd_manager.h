@@ -3,14 +3,30 @@
 
 #include <Arduino.h>
 
+// Requête transmise à sdTask par sdQueue dans un LineSlab : text = nom du fichier,
+// line_number = ligne ou couche de départ, offset = SdRequest
+enum class SdRequest : uint32_t {
+  PLAY, PLAY_FROM_LINE, PLAY_FROM_LAYER, INDEX, RESUME, SCAN, REFRESH
+};
+
 class SDManager {
 private:
+  bool sendRequest(String filename, SdRequest kind, int32_t start);
+
 public:
   bool init();
   void readFile(String filename);
+  void readFileFrom(String filename, bool by_layer, int32_t start); // Nécessite indexFile
+  void indexFile(String filename);    // Construit <nom>.idx en tâche de fond
+  void resume();                      // Reprend au dernier point de reprise
+  void scanFile(String filename);     // Résumé en tâche de fond ; nom vide : toute la racine
   void testReadSD(String filename);
-  void listFiles();
+  // Page de l'arborescence en cache ; sans compte, tout le dossier
+  void listFiles(String path = "/", uint32_t offset = 0, uint32_t count = UINT32_MAX);
+  void refreshFiles();                // Relit l'arborescence après un changement hors firmware
+  void printReadStats();
   static void sdTask(void *pvParameters);
+  static void preparseTask(void *pvParameters); // Cœur 0, si SD_PARALLEL_PARSE
 };
 
 extern SDManager sdManager;
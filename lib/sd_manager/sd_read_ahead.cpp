@@ -0,0 +1,162 @@
+#include "sd_read_ahead.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include "../debug_manager.h"
+
+extern SemaphoreHandle_t errorSemaphore;
+
+SdReadAhead sdReadAhead;
+
+bool SdReadAhead::init() {
+  const size_t size = SD_READ_BUFFER_BYTES + SD_READ_AHEAD_BLOCK_BYTES;
+  for (uint8_t n = 0; n < SD_READ_AHEAD_BUFFERS; n++) {
+    blocks[n].memory = static_cast<char *>(heap_caps_aligned_alloc(32, size, MALLOC_CAP_DMA));
+#if SD_READ_AHEAD_PSRAM
+    if (!blocks[n].memory) blocks[n].memory = static_cast<char *>(heap_caps_aligned_alloc(32, size, MALLOC_CAP_SPIRAM));
+#endif
+    if (!blocks[n].memory) {
+      DEBUG_PRINTF_AUTO("Erreur: Allocation du bloc de lecture %u (%u octets) impossible", n, (unsigned)size);
+      return false;
+    }
+  }
+  free_blocks = xQueueCreate(SD_READ_AHEAD_BUFFERS, sizeof(uint8_t));
+  full_blocks = xQueueCreate(SD_READ_AHEAD_BUFFERS, sizeof(uint8_t));
+  card_mutex = xSemaphoreCreateMutex();
+  if (!free_blocks || !full_blocks || !card_mutex ||
+      xTaskCreatePinnedToCore(readerTask, "ReadAheadTask", 4096, this, 2, &reader, 0) != pdPASS) {
+    DEBUG_PRINTF_AUTO("Erreur: Impossible de créer ReadAheadTask");
+    return false;
+  }
+  DEBUG_PRINTF_AUTO("Lecture anticipée: %u blocs de %u octets", SD_READ_AHEAD_BUFFERS, SD_READ_AHEAD_BLOCK_BYTES);
+  return true;
+}
+
+// Cœur 0 : remplit les blocs libres jusqu'à la fin du fichier ou jusqu'à end()
+void SdReadAhead::readerTask(void *pvParameters) {
+  SdReadAhead &self = *static_cast<SdReadAhead *>(pvParameters);
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // begin()
+    bool last = false;
+    while (!last) {
+      uint8_t index;
+      xQueueReceive(self.free_blocks, &index, portMAX_DELAY);
+      Block &block = self.blocks[index];
+      block.len = 0;
+      if (!self.stop) {
+        self.lockCard();
+        int64_t started = esp_timer_get_time();
+        while (block.len < SD_READ_AHEAD_BLOCK_BYTES) {
+          int bytesRead = self.file->read(block.memory + SD_READ_BUFFER_BYTES + block.len,
+                                          SD_READ_AHEAD_BLOCK_BYTES - block.len);
+          if (bytesRead <= 0) break;
+          block.len += bytesRead;
+        }
+        self.read_us += esp_timer_get_time() - started;
+        self.unlockCard();
+      }
+      last = self.stop || block.len < SD_READ_AHEAD_BLOCK_BYTES;
+      block.last = last;
+      xQueueSend(self.full_blocks, &index, portMAX_DELAY);
+    }
+  }
+}
+
+void SdReadAhead::begin(File32 &source) {
+  // Départ ramené au début de son secteur : les blocs suivants restent alignés
+  uint32_t position = source.curPosition();
+  skip = position % SD_SECTOR_BYTES;
+  if (skip && !source.seekSet(position - skip)) {
+    skip = 0;
+    source.seekSet(position);
+  }
+  xQueueReset(free_blocks);
+  xQueueReset(full_blocks);
+  for (uint8_t n = 0; n < SD_READ_AHEAD_BUFFERS; n++) xQueueSend(free_blocks, &n, 0);
+  file = &source;
+  stop = false;
+  current = -1;
+  window = NULL;
+  window_len = 0;
+  finished = false;
+  bytes = read_us = elapsed_us = 0;
+  started_us = esp_timer_get_time();
+  xTaskNotifyGive(reader);
+}
+
+void SdReadAhead::consume(size_t count) {
+  if (count > window_len) count = window_len;
+  window += count;
+  window_len -= count;
+}
+
+bool SdReadAhead::refill() {
+  if (finished) return false;
+  if (window_len > SD_READ_BUFFER_BYTES) {
+    // La marge ne peut pas tout recopier : le lecteur devait consommer la ligne trop longue
+    DEBUG_PRINTF_AUTO("Erreur: %u octets non consommés avant refill, %u au plus", (unsigned)window_len,
+                      (unsigned)SD_READ_BUFFER_BYTES);
+    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    return false;
+  }
+  uint8_t index;
+  xQueueReceive(full_blocks, &index, portMAX_DELAY);
+  Block &block = blocks[index];
+
+  // Fin de ligne incomplète recopiée juste devant les nouvelles données
+  size_t carry = window_len;
+  char *start = block.memory + SD_READ_BUFFER_BYTES - carry;
+  if (carry) memcpy(start, window, carry);
+  if (current >= 0) {
+    uint8_t previous = current;
+    xQueueSend(free_blocks, &previous, portMAX_DELAY);
+  }
+  current = index;
+  window = start;
+  window_len = carry + block.len;
+  // Premier bloc d'un départ non aligné : les octets avant le départ sont sautés
+  size_t skipped = skip < block.len ? skip : block.len;
+  window += skipped;
+  window_len -= skipped;
+  skip = 0;
+  bytes += block.len - skipped;
+  if (block.last) {
+    finished = true;
+    elapsed_us = esp_timer_get_time() - started_us;
+  }
+  return block.len > 0;
+}
+
+void SdReadAhead::end() {
+  // Attend le dernier bloc de ReadAheadTask pour qu'il ne touche plus au fichier
+  stop = true;
+  while (!finished) {
+    uint8_t index;
+    xQueueReceive(full_blocks, &index, portMAX_DELAY);
+    finished = blocks[index].last;
+    xQueueSend(free_blocks, &index, portMAX_DELAY);
+  }
+  if (!elapsed_us) elapsed_us = esp_timer_get_time() - started_us;
+  current = -1;
+  window = NULL;
+  window_len = 0;
+  file = NULL;
+  DEBUG_PRINTF_AUTO("Lecture SD: %lu octets en %lu ms, %lu o/s (carte: %lu o/s)", (unsigned long)bytes,
+                    (unsigned long)lastMillis(), (unsigned long)pipelineBytesPerSecond(),
+                    (unsigned long)cardBytesPerSecond());
+}
+
+bool SdReadAhead::lockCard(TickType_t ticks_to_wait) {
+  return !card_mutex || xSemaphoreTake(card_mutex, ticks_to_wait) == pdTRUE;
+}
+
+void SdReadAhead::unlockCard() {
+  if (card_mutex) xSemaphoreGive(card_mutex);
+}
+
+uint32_t SdReadAhead::pipelineBytesPerSecond() const {
+  return elapsed_us ? static_cast<uint32_t>(bytes * 1000000ULL / elapsed_us) : 0;
+}
+
+uint32_t SdReadAhead::cardBytesPerSecond() const {
+  return read_us ? static_cast<uint32_t>(bytes * 1000000ULL / read_us) : 0;
+}
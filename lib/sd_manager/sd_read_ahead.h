@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "../config.h"
+
+// Lecture anticipée d'un fichier texte : ReadAheadTask remplit des blocs alignés de
+// SD_READ_AHEAD_BLOCK_BYTES (lectures multi-secteurs directes, sans tampon SdFat)
+// pendant que le lecteur découpe les lignes du bloc précédent en place. Un départ en
+// cours de fichier (index, reprise) lit depuis le début du secteur qui le contient et
+// saute les octets qui le précèdent, pour que tous les blocs restent alignés.
+//
+// Le lecteur voit une fenêtre contiguë d'octets non consommés. Chaque bloc est précédé
+// de SD_READ_BUFFER_BYTES de marge : refill() y recopie la fin de ligne incomplète du
+// bloc précédent, si bien qu'une ligne n'est jamais coupée entre deux blocs.
+class SdReadAhead {
+private:
+  struct Block {
+    char *memory;   // Marge puis données
+    size_t len;     // Octets lus
+    bool last;      // Fin de fichier ou lecture interrompue
+  };
+
+  Block blocks[SD_READ_AHEAD_BUFFERS];
+  QueueHandle_t free_blocks;   // Indices des blocs à remplir
+  QueueHandle_t full_blocks;   // Indices des blocs lus, dans l'ordre du fichier
+  TaskHandle_t reader;
+  SemaphoreHandle_t card_mutex; // Lectures de ReadAheadTask contre les autres accès à la carte
+  File32 *volatile file;
+  volatile bool stop;          // Demande d'arrêt avant la fin du fichier
+  int8_t current;              // Bloc détenu par le lecteur, -1 sinon
+  const char *window;
+  size_t window_len;
+  bool finished;               // Dernier bloc reçu
+  size_t skip;                 // Octets du premier secteur avant la position de départ
+  uint32_t bytes;
+  int64_t read_us;             // Temps passé dans file.read par ReadAheadTask
+  int64_t started_us;
+  int64_t elapsed_us;
+
+  static void readerTask(void *pvParameters);
+
+public:
+  SdReadAhead() : free_blocks(NULL), full_blocks(NULL), reader(NULL), card_mutex(NULL), file(NULL), stop(false),
+                  current(-1), window(NULL), window_len(0), finished(true), skip(0),
+                  bytes(0), read_us(0), started_us(0), elapsed_us(0) {}
+  bool init();                  // Blocs en mémoire DMA (ou PSRAM) et ReadAheadTask sur le cœur 0
+  void begin(File32 &source);   // Lecture depuis la position courante de source
+  // Fenêtre des octets reçus et non consommés
+  const char *data(size_t &len) const {
+    len = window_len;
+    return window;
+  }
+  size_t available() const { return window_len; }
+  void consume(size_t count);
+  // Ajoute le bloc suivant à la fenêtre, derrière les octets non consommés. Retourne false
+  // en fin de fichier, ou sans rien lire s'il en reste plus de SD_READ_BUFFER_BYTES.
+  bool refill();
+  void end();                   // Arrête la lecture et rend les blocs ; source reste ouverte
+  // Accès à la carte par une autre tâche pendant une lecture (points de reprise)
+  bool lockCard(TickType_t ticks_to_wait = portMAX_DELAY);
+  void unlockCard();
+
+  // Statistiques du dernier fichier
+  uint32_t lastBytes() const { return bytes; }
+  uint32_t lastMillis() const { return static_cast<uint32_t>(elapsed_us / 1000); }
+  uint32_t pipelineBytesPerSecond() const;
+  uint32_t cardBytesPerSecond() const;
+};
+
+extern SdReadAhead sdReadAhead;
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <string.h>
+#include <type_traits>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "../config.h"
+
+// File sans verrou entre un producteur et un consommateur, de type et de capacité fixés
+// à la compilation. Aucune section critique du noyau : un ajout ou un retrait se résume
+// à une copie et à la publication d'un indice.
+//
+// Les indices tournent sur 2 x Capacity, ce qui distingue plein et vide sans case
+// sacrifiée, quelle que soit la capacité. Chaque côté garde une copie de l'indice de
+// l'autre et ne relit l'indice partagé que lorsqu'elle ne suffit plus ; les données de
+// chaque côté occupent leur propre ligne de cache (SPSC_CACHE_LINE).
+//
+// Un côté qui doit attendre s'endort sur un sémaphore binaire propre à ce côté (créé par
+// init()) et l'autre côté le réveille. La notification de tâche reste libre pour les
+// autres réveils de la tâche (réception UART, blocs prêts). Plusieurs tâches peuvent produire (ou consommer) à condition d'être
+// sérialisées par un mutex.
+template <typename T, size_t Capacity>
+class SpscRing {
+private:
+  static_assert(Capacity > 0, "SpscRing: capacité nulle");
+  static_assert(std::is_trivially_copyable<T>::value, "SpscRing: T doit être copiable par memcpy");
+  static const size_t WRAP = 2 * Capacity;
+
+  // Producteur
+  alignas(SPSC_CACHE_LINE) std::atomic<size_t> head;  // Prochaine écriture
+  size_t cached_tail;
+  std::atomic<bool> producer_waiting;                 // Producteur endormi sur producer_wakeup
+  SemaphoreHandle_t producer_wakeup;
+  // Consommateur
+  alignas(SPSC_CACHE_LINE) std::atomic<size_t> tail;  // Prochaine lecture
+  size_t cached_head;
+  std::atomic<bool> consumer_waiting;
+  SemaphoreHandle_t consumer_wakeup;
+  alignas(SPSC_CACHE_LINE) T items[Capacity];
+
+  static size_t distance(size_t from, size_t to) { return to >= from ? to - from : to + WRAP - from; }
+  static size_t advance(size_t index, size_t count) {
+    index += count;
+    return index >= WRAP ? index - WRAP : index;
+  }
+  static size_t slot(size_t index) { return index >= Capacity ? index - Capacity : index; }
+
+  static void wake(std::atomic<bool> &waiting, SemaphoreHandle_t wakeup) {
+    // Ordonne la publication de l'indice avant la lecture de l'attente (cf. wait)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!waiting.load(std::memory_order_relaxed)) return;
+    if (waiting.exchange(false)) xSemaphoreGive(wakeup);
+  }
+
+  // Attend que ready() devienne vrai ; ticks_to_wait borne l'attente sans progrès de
+  // l'autre côté, comme FlowControl::admit
+  template <typename Ready>
+  static bool wait(std::atomic<bool> &waiting, SemaphoreHandle_t wakeup, Ready ready, TickType_t ticks_to_wait) {
+    if (ready()) return true;
+    if (ticks_to_wait == 0 || !wakeup) return false;
+    while (1) {
+      // Attente publiée avant le contrôle : l'autre côté la voit ou nous voyons ses données.
+      // Un jeton resté d'un réveil précédent provoque seulement un nouveau contrôle.
+      waiting.store(true);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready()) break;
+      if (xSemaphoreTake(wakeup, ticks_to_wait) != pdTRUE && !ready()) {
+        waiting.store(false);
+        return false;
+      }
+    }
+    waiting.store(false);
+    return true;
+  }
+
+  size_t writable() {
+    cached_tail = tail.load(std::memory_order_acquire);
+    return Capacity - distance(cached_tail, head.load(std::memory_order_relaxed));
+  }
+
+  size_t readable() {
+    cached_head = head.load(std::memory_order_acquire);
+    return distance(tail.load(std::memory_order_relaxed), cached_head);
+  }
+
+public:
+  SpscRing()
+      : head(0), cached_tail(0), producer_waiting(false), producer_wakeup(NULL), tail(0), cached_head(0),
+        consumer_waiting(false), consumer_wakeup(NULL) {}
+
+  // Sémaphores de réveil ; sans eux, les attentes bloquantes échouent aussitôt
+  bool init() {
+    if (!producer_wakeup) producer_wakeup = xSemaphoreCreateBinary();
+    if (!consumer_wakeup) consumer_wakeup = xSemaphoreCreateBinary();
+    return producer_wakeup && consumer_wakeup;
+  }
+
+  static size_t capacity() { return Capacity; }
+
+  // Producteur : ajoute jusqu'à count éléments, retourne le nombre ajouté
+  size_t pushBatch(const T *data, size_t count) {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t space = Capacity - distance(cached_tail, h);
+    if (space < count) space = writable();
+    if (count > space) count = space;
+    if (!count) return 0;
+    size_t first = slot(h);
+    size_t chunk = Capacity - first < count ? Capacity - first : count;
+    memcpy(&items[first], data, chunk * sizeof(T));
+    if (count > chunk) memcpy(&items[0], data + chunk, (count - chunk) * sizeof(T));
+    head.store(advance(h, count), std::memory_order_release);
+    wake(consumer_waiting, consumer_wakeup);
+    return count;
+  }
+
+  // Producteur : ajoute les count éléments d'un bloc, ou rien
+  bool pushAll(const T *data, size_t count) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (Capacity - distance(cached_tail, h) < count && writable() < count) return false;
+    return pushBatch(data, count) == count;
+  }
+
+  bool push(const T &item) { return pushAll(&item, 1); }
+
+  // Consommateur : retire jusqu'à max éléments, retourne le nombre retiré
+  size_t popBatch(T *data, size_t max) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t count = distance(t, cached_head);
+    if (count < max) count = readable();
+    if (count > max) count = max;
+    if (!count) return 0;
+    size_t first = slot(t);
+    size_t chunk = Capacity - first < count ? Capacity - first : count;
+    memcpy(data, &items[first], chunk * sizeof(T));
+    if (count > chunk) memcpy(data + chunk, &items[0], (count - chunk) * sizeof(T));
+    tail.store(advance(t, count), std::memory_order_release);
+    wake(producer_waiting, producer_wakeup);
+    return count;
+  }
+
+  // Consommateur : retire exactement count éléments, ou rien
+  bool popAll(T *data, size_t count) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (distance(t, cached_head) < count && readable() < count) return false;
+    return popBatch(data, count) == count;
+  }
+
+  bool pop(T &item) { return popAll(&item, 1); }
+
+  // Attentes bloquantes sur le sémaphore de réveil de chaque côté
+  bool waitForSpace(size_t count, TickType_t ticks_to_wait) {
+    return wait(producer_waiting, producer_wakeup, [this, count]() { return writable() >= count; }, ticks_to_wait);
+  }
+  bool waitForData(size_t count, TickType_t ticks_to_wait) {
+    return wait(consumer_waiting, consumer_wakeup, [this, count]() { return readable() >= count; }, ticks_to_wait);
+  }
+
+  // Consommateur (ou producteur à l'arrêt) : abandonne le contenu et réveille le producteur
+  void clear() {
+    cached_head = head.load(std::memory_order_acquire);
+    tail.store(cached_head, std::memory_order_release);
+    wake(producer_waiting, producer_wakeup);
+  }
+
+  // Remplissage vu depuis n'importe quelle tâche (instantané)
+  size_t size() const {
+    size_t t = tail.load(std::memory_order_acquire);
+    size_t used = distance(t, head.load(std::memory_order_acquire));
+    return used > Capacity ? Capacity : used; // tail relu avant un nouvel ajout
+  }
+  size_t freeSpace() const { return Capacity - size(); }
+};
@@ -3,6 +3,8 @@
 #include "sd_manager.h"
 #include "comm_manager.h"
 #include "gcode_parser.h"
+#include "motion_queue.h"
+#include "../config.h"
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
@@ -17,7 +19,6 @@
 
 QueueHandle_t gcodeQueue = NULL;
 QueueHandle_t sdQueue = NULL;
-QueueHandle_t motionQueue = NULL;
 SemaphoreHandle_t errorSemaphore = NULL;
 SystemManager systemManager;
 CRGB leds[NUM_LEDS];
@@ -48,8 +49,8 @@ void SystemManager::systemTask(void *pvParameters) {
       DEBUG_PRINTF_AUTO("Erreur détectée, arrêt d'urgence");
       leds[0] = CRGB::Red;
       FastLED.show();
-      xQueueReset(sdQueue);
-      xQueueReset(gcodeQueue);
+      linePool.drain(sdQueue);
+      clearGcodeQueue();
     }
     vTaskDelay(pdMS_TO_TICKS(100));
   }
@@ -58,10 +59,10 @@ void SystemManager::systemTask(void *pvParameters) {
 void SystemManager::init() {
   DEBUG_PRINTF_AUTO("Initialisation du System Manager");
   stabilisation();
-  gcodeQueue = xQueueCreate(10, sizeof(String));
-  sdQueue = xQueueCreate(5, sizeof(String));
-  motionQueue = xQueueCreate(10, sizeof(MotionCommand));
-  if (!gcodeQueue || !sdQueue || !motionQueue) {
+  // Les queues de lignes ne transportent que des pointeurs vers les slabs du pool
+  gcodeQueue = xQueueCreate(GCODE_QUEUE_LENGTH, sizeof(LineSlab *));
+  sdQueue = xQueueCreate(SD_QUEUE_LENGTH, sizeof(LineSlab *));
+  if (!linePool.init() || !gcodeQueue || !sdQueue || !motionQueue.init()) {
     DEBUG_PRINTF_AUTO("Erreur: Impossible de créer les queues");
     if (errorSemaphore) xSemaphoreGive(errorSemaphore);
     return;
@@ -84,20 +85,25 @@ void SystemManager::init() {
     CommManager::commTask, "CommTask", 4096, NULL, 1, NULL, 1
   );
   xTaskCreatePinnedToCore(
-    SDManager::sdTask, "SDTask", 4096, NULL, 1, NULL, 1
+    SDManager::sdTask, "SDTask", 6144, NULL, 1, NULL, 1
   );
   xTaskCreatePinnedToCore(
-    GcodeParser::parserTask, "ParserTask", 4096, NULL, 3, NULL, 1
+    GcodeParser::parserTask, "ParserTask", 6144, NULL, 3, NULL, 1
   );
   xTaskCreatePinnedToCore(
     systemTask, "SystemTask", 2048, NULL, 1, NULL, 1
   );
+#if SD_FUSED_PARSE && SD_PARALLEL_PARSE
+  xTaskCreatePinnedToCore(
+    SDManager::preparseTask, "PreparseTask", 4096, NULL, 1, NULL, 0
+  );
+#endif
   delay(1000);
 }
 
 void SystemManager::testSystem() {
   DEBUG_PRINTF_AUTO("Test System Manager: Vérification des ressources");
-  if (gcodeQueue && sdQueue && motionQueue && errorSemaphore) {
+  if (gcodeQueue && sdQueue && motionQueue.isReady() && errorSemaphore) {
     DEBUG_PRINTF_AUTO("Toutes les ressources sont initialisées");
   } else {
     DEBUG_PRINTF_AUTO("Erreur: Certaines ressources non initialisées");
@@ -16,5 +16,4 @@ public:
 extern SystemManager systemManager;
 extern QueueHandle_t gcodeQueue;
 extern QueueHandle_t sdQueue;
-extern QueueHandle_t motionQueue;
 extern SemaphoreHandle_t errorSemaphore;
@@ -0,0 +1,221 @@
+// Compare sur l'hôte l'évaluation des expressions paramétriques du firmware
+// (gcode_expression.h : compilées une fois en bytecode, puis exécutées par la machine à
+// pile) à un interpréteur naïf qui relit le texte à chaque évaluation, comme le ferait
+// un sous-programme M98 sans cache. Les deux chemins doivent donner le même résultat.
+//
+// Construction sur l'hôte, depuis la racine du dépôt :
+//   g++ -O2 -std=c++11 -Ilib/gcode_parser -o expression_bench
+//       tools/expression_bench/expression_bench.cpp lib/gcode_parser/gcode_expression.cpp
+//       lib/gcode_parser/gcode_number.cpp
+//
+// Utilisation : expression_bench [évaluations par expression] [répétitions]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "gcode_expression.h"
+
+// Expressions typiques d'un G-code paramétrique : décalage par couche, condition de
+// boucle, trigonométrie d'un motif circulaire
+static const char *const kExpressions[] = {
+    "#1",
+    "[#1 * 0.2 + 5]",
+    "[#2 GT 0.6]",
+    "[[#3 + 1] MOD 4 EQ 0 AND #4 LT 100]",
+    "[#5 * COS[#6 * 15] + #7]",
+    "[SQRT[#1 * #1 + #2 * #2] / [#8 + 1]]",
+    "[ROUND[#9 / 0.4] * 0.4 - ABS[#10]]",
+};
+
+static const float kDegreesToRadians = 0.0174532925f;
+static const float kEqualTolerance = 1e-6f;
+
+// Interpréteur de référence : descente récursive sur le texte, même grammaire et mêmes
+// opérations float que la machine à pile, nombres lus par strtof
+struct NaiveInterpreter {
+  const char *p;
+  const float *variables;
+  bool ok;
+
+  void skipBlanks() {
+    while (*p == ' ' || *p == '\t') p++;
+  }
+  bool keyword(const char *name) {
+    skipBlanks();
+    size_t len = strlen(name);
+    for (size_t i = 0; i < len; i++) {
+      char c = p[i];
+      if (c >= 'a' && c <= 'z') c = static_cast<char>(c - 'a' + 'A');
+      if (c != name[i]) return false;
+    }
+    p += len;
+    return true;
+  }
+  bool symbol(char c) {
+    skipBlanks();
+    if (*p != c) return false;
+    p++;
+    return true;
+  }
+  float fail() {
+    ok = false;
+    return 0.0f;
+  }
+
+  float bracketed() {
+    if (!symbol('[')) return fail();
+    float value = expression();
+    if (!symbol(']')) return fail();
+    return value;
+  }
+  float unary() {
+    if (symbol('-')) return -unary();
+    if (symbol('+')) return unary();
+    skipBlanks();
+    if (*p == '#') {
+      char *after;
+      long index = strtol(p + 1, &after, 10);
+      if (after == p + 1 || index < 0 || index >= GCODE_VARIABLE_COUNT) return fail();
+      p = after;
+      return variables[index];
+    }
+    if (*p == '[') return bracketed();
+    if (*p == '.' || (*p >= '0' && *p <= '9')) {
+      char *after;
+      float value = strtof(p, &after);
+      p = after;
+      return value;
+    }
+    if (keyword("ABS")) return fabsf(bracketed());
+    if (keyword("SQRT")) {
+      float a = bracketed();
+      return a < 0.0f ? fail() : sqrtf(a);
+    }
+    if (keyword("SIN")) return sinf(bracketed() * kDegreesToRadians);
+    if (keyword("COS")) return cosf(bracketed() * kDegreesToRadians);
+    if (keyword("ROUND")) return roundf(bracketed());
+    if (keyword("FIX")) return floorf(bracketed());
+    return fail();
+  }
+  float product() {
+    float a = unary();
+    while (ok) {
+      if (symbol('*')) {
+        a *= unary();
+      } else if (symbol('/')) {
+        float b = unary();
+        if (b == 0.0f) return fail();
+        a /= b;
+      } else if (keyword("MOD")) {
+        float b = unary();
+        if (b == 0.0f) return fail();
+        a = fmodf(a, b);
+      } else {
+        break;
+      }
+    }
+    return a;
+  }
+  float sum() {
+    float a = product();
+    while (ok) {
+      if (symbol('+')) a += product();
+      else if (symbol('-')) a -= product();
+      else break;
+    }
+    return a;
+  }
+  float comparison() {
+    float a = sum();
+    if (keyword("EQ")) return fabsf(a - sum()) <= kEqualTolerance ? 1.0f : 0.0f;
+    if (keyword("NE")) return fabsf(a - sum()) > kEqualTolerance ? 1.0f : 0.0f;
+    if (keyword("GT")) return a > sum() ? 1.0f : 0.0f;
+    if (keyword("GE")) return a >= sum() ? 1.0f : 0.0f;
+    if (keyword("LT")) return a < sum() ? 1.0f : 0.0f;
+    if (keyword("LE")) return a <= sum() ? 1.0f : 0.0f;
+    return a;
+  }
+  float conjunction() {
+    float a = comparison();
+    while (ok && keyword("AND")) {
+      float b = comparison();
+      a = (a != 0.0f && b != 0.0f) ? 1.0f : 0.0f;
+    }
+    return a;
+  }
+  float expression() {
+    float a = conjunction();
+    while (ok && keyword("OR")) {
+      float b = conjunction();
+      a = (a != 0.0f || b != 0.0f) ? 1.0f : 0.0f;
+    }
+    return a;
+  }
+};
+
+static bool evaluateNaive(const char *text, const float *variables, float &result) {
+  NaiveInterpreter interpreter = {text, variables, true};
+  result = interpreter.unary(); // "#n", "-#n" ou "[...]", comme une valeur de paramètre
+  return interpreter.ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 3) {
+    fprintf(stderr, "Usage: %s [evaluations] [repeat]\n", argv[0]);
+    return 2;
+  }
+  long evaluations = argc >= 2 ? atol(argv[1]) : 1000000;
+  int repeat = argc == 3 ? atoi(argv[2]) : 5;
+  if (evaluations < 1) evaluations = 1;
+  if (repeat < 1) repeat = 1;
+
+  float variables[GCODE_VARIABLE_COUNT];
+  for (int n = 0; n < GCODE_VARIABLE_COUNT; n++) variables[n] = 0.25f * n + 0.5f;
+
+  printf("%-40s %5s %10s %10s %7s\n", "expression", "bytes", "naive ns", "vm ns", "speedup");
+  int failures = 0;
+  for (size_t e = 0; e < sizeof(kExpressions) / sizeof(kExpressions[0]); e++) {
+    const char *text = kExpressions[e];
+    uint8_t code[64];
+    uint8_t size = 0;
+    const char *p = text;
+    if (!compileGcodeExpression(p, text + strlen(text), code, size, sizeof(code), false)) {
+      fprintf(stderr, "ERROR: cannot compile %s\n", text);
+      return 1;
+    }
+
+    // Une variable change à chaque évaluation, comme le compteur d'une boucle M98
+    double best_naive = 0.0, best_vm = 0.0;
+    float sum_naive = 0.0f, sum_vm = 0.0f;
+    for (int r = 0; r < repeat; r++) {
+      float sum = 0.0f, value;
+      std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+      for (long n = 0; n < evaluations; n++) {
+        variables[1] = static_cast<float>(n & 1023);
+        if (evaluateNaive(text, variables, value)) sum += value;
+      }
+      double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+      if (r == 0 || elapsed < best_naive) best_naive = elapsed;
+      sum_naive = sum;
+
+      sum = 0.0f;
+      started = std::chrono::steady_clock::now();
+      for (long n = 0; n < evaluations; n++) {
+        variables[1] = static_cast<float>(n & 1023);
+        if (evaluateGcodeExpression(code, variables, value)) sum += value;
+      }
+      elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+      if (r == 0 || elapsed < best_vm) best_vm = elapsed;
+      sum_vm = sum;
+    }
+    if (sum_naive != sum_vm) {
+      fprintf(stderr, "ERROR: results differ for %s (%g vs %g)\n", text, sum_naive, sum_vm);
+      failures++;
+    }
+    printf("%-40s %5u %10.1f %10.1f   x%.2f\n", text, size, best_naive * 1e9 / evaluations,
+           best_vm * 1e9 / evaluations, best_naive / best_vm);
+  }
+  return failures ? 1 : 0;
+}
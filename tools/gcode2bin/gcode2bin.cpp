@@ -0,0 +1,99 @@
+// Convertit un fichier G-code texte en G-code binaire pré-découpé (.gcb)
+// lu directement par sdTask, sans découpage de texte sur l'ESP32.
+//
+// Construction sur l'hôte, depuis la racine du dépôt :
+//   g++ -O2 -std=c++11 -Ilib/gcode_parser -o gcode2bin tools/gcode2bin/gcode2bin.cpp
+//       lib/gcode_parser/gcode_tokenizer.cpp lib/gcode_parser/gcode_number.cpp
+//       lib/gcode_parser/gcode_binary.cpp lib/gcode_parser/gcode_expression.cpp
+//
+// Utilisation : gcode2bin entree.gcode sortie.gcb
+//
+// Le résumé donne aussi le débit du tokenizer partagé avec le firmware (découpage et
+// encodage seuls, hors lecture du fichier), pour mesurer ses optimisations sur de vrais
+// fichiers de slicer.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "gcode_binary.h"
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s input.gcode output.gcb\n", argv[0]);
+    return 2;
+  }
+  FILE *in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "ERROR: cannot open %s\n", argv[1]);
+    return 1;
+  }
+  FILE *out = fopen(argv[2], "wb");
+  if (!out) {
+    fprintf(stderr, "ERROR: cannot create %s\n", argv[2]);
+    fclose(in);
+    return 1;
+  }
+
+  // En-tête provisoire, réécrit à la fin avec le nombre de commandes
+  uint8_t header[GCODE_BINARY_HEADER_SIZE];
+  writeGcodeBinaryHeader(header, 0);
+  fwrite(header, 1, sizeof(header), out);
+
+  GcodeBinaryState state;
+  state.reset();
+  char line[1024];
+  uint8_t record[GCODE_BINARY_MAX_RECORD];
+  unsigned long line_number = 0, bytes_in = 0, bytes_out = sizeof(header);
+  uint32_t commands = 0;
+  int result = 0;
+  std::chrono::steady_clock::duration tokenize_time(0);
+
+  while (fgets(line, sizeof(line), in)) {
+    line_number++;
+    size_t len = strlen(line);
+    bytes_in += len;
+    if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+      fprintf(stderr, "ERROR: line %lu: too long\n", line_number);
+      result = 1;
+      break;
+    }
+
+    TokenizedLine words;
+    size_t column;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    TokenStatus status = tokenizeWords(line, len, words, column);
+    if (status == TokenStatus::EMPTY) continue;
+    if (status != TokenStatus::OK) {
+      fprintf(stderr, "ERROR: line %lu, column %u: %s\n", line_number,
+              static_cast<unsigned>(column + 1), tokenStatusMessage(status));
+      result = 1;
+      break;
+    }
+    size_t size = encodeGcodeRecord(words, state, record);
+    tokenize_time += std::chrono::steady_clock::now() - started;
+    if (size == 0) {
+      fprintf(stderr, "ERROR: line %lu: %s\n", line_number, tokenStatusMessage(TokenStatus::UNKNOWN_PARAMETER));
+      result = 1;
+      break;
+    }
+    fwrite(record, 1, size, out);
+    bytes_out += size;
+    commands++;
+  }
+
+  if (result == 0) {
+    writeGcodeBinaryHeader(header, commands);
+    fseek(out, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), out);
+    double seconds = std::chrono::duration<double>(tokenize_time).count();
+    printf("%lu lines, %lu commands, %lu -> %lu bytes\n", line_number,
+           static_cast<unsigned long>(commands), bytes_in, bytes_out);
+    if (seconds > 0.0) {
+      printf("tokenize+encode: %.0f lines/s, %.1f MB/s\n", line_number / seconds, bytes_in / seconds / 1e6);
+    }
+  }
+  fclose(in);
+  if (fclose(out) != 0) result = 1;
+  if (result != 0) remove(argv[2]);
+  return result;
+}
@@ -0,0 +1,172 @@
+// Compare sur l'hôte le décodeur décimal du firmware (gcode_number.h) à l'ancienne
+// conversion de parseParameters : String::substring(1).toFloat(), soit une copie allouée
+// puis atof, et à strtof seul. Chaque champ numérique du fichier est converti par les
+// trois chemins ; les écarts à la valeur exacte (double) sont relevés en même temps.
+//
+// Construction sur l'hôte, depuis la racine du dépôt :
+//   g++ -O2 -std=c++11 -Ilib/gcode_parser -o number_bench
+//       tools/number_bench/number_bench.cpp lib/gcode_parser/gcode_number.cpp
+//
+// Utilisation : number_bench fichier.gcode [répétitions]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "gcode_number.h"
+
+// Champ lettre + nombre, repéré une fois pour toutes dans le fichier
+struct Field {
+  uint32_t start, length; // Nombre seul, sans la lettre
+};
+
+// Champs des lignes hors commentaires ';' et '(...)', séparés par des blancs comme
+// l'attendait l'ancien parseParameters
+static void collectFields(const std::vector<char> &data, std::vector<Field> &fields, uint32_t &lines) {
+  size_t n = 0, size = data.size();
+  lines = 0;
+  while (n < size) {
+    size_t end = n;
+    while (end < size && data[end] != '\n') end++;
+    lines++;
+    bool comment = false;
+    for (size_t p = n; p < end; p++) {
+      char c = data[p];
+      if (c == ';') break;
+      if (c == '(') comment = true;
+      if (comment) {
+        if (c == ')') comment = false;
+        continue;
+      }
+      if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))) continue;
+      size_t q = p + 1;
+      while (q < end && (data[q] == '-' || data[q] == '+' || data[q] == '.' || (data[q] >= '0' && data[q] <= '9'))) q++;
+      if (q > p + 1) {
+        Field field = {static_cast<uint32_t>(p + 1), static_cast<uint32_t>(q - p - 1)};
+        fields.push_back(field);
+      }
+      p = q - 1;
+    }
+    n = end + 1;
+  }
+}
+
+typedef double (*Converter)(const char *text, uint32_t length, double &sum);
+
+// Ancien chemin : sous-chaîne allouée (String::substring) puis atof (String::toFloat)
+static double viaString(const char *text, uint32_t length, double &sum) {
+  std::string copy(text, length);
+  float value = static_cast<float>(atof(copy.c_str()));
+  sum += value;
+  return value;
+}
+
+// strtof sur une copie sur la pile : le champ n'est pas terminé par '\0' dans le fichier
+static double viaStrtof(const char *text, uint32_t length, double &sum) {
+  char copy[32];
+  if (length >= sizeof(copy)) length = sizeof(copy) - 1;
+  memcpy(copy, text, length);
+  copy[length] = '\0';
+  float value = strtof(copy, NULL);
+  sum += value;
+  return value;
+}
+
+static double viaDecimal(const char *text, uint32_t length, double &sum) {
+  const char *p = text;
+  GcodeDecimal decimal;
+  if (!scanGcodeDecimal(p, text + length, decimal)) return 0.0;
+  float value = gcodeDecimalToFloat(decimal);
+  sum += value;
+  return value;
+}
+
+static double viaScaled(const char *text, uint32_t length, double &sum) {
+  const char *p = text;
+  GcodeDecimal decimal;
+  if (!scanGcodeDecimal(p, text + length, decimal)) return 0.0;
+  int32_t value = gcodeDecimalToScaled(decimal, 3); // mm -> µm
+  sum += value;
+  return value / 1000.0;
+}
+
+struct Result {
+  double best;     // Secondes, meilleure répétition
+  double sum;      // Empêche l'élimination des conversions
+  double max_error; // Écart maximal à la valeur exacte, en unités du champ
+  uint32_t inexact; // Champs dont la valeur diffère de l'arrondi float exact
+};
+
+static Result run(const std::vector<char> &data, const std::vector<Field> &fields, Converter convert, int repeat) {
+  Result result = {0.0, 0.0, 0.0, 0};
+  for (int r = 0; r < repeat; r++) {
+    double sum = 0.0;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < fields.size(); n++) convert(data.data() + fields[n].start, fields[n].length, sum);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (r == 0 || elapsed < result.best) result.best = elapsed;
+    result.sum = sum;
+  }
+  // Précision, hors chronométrage : référence strtod en double
+  for (size_t n = 0; n < fields.size(); n++) {
+    char copy[32];
+    uint32_t length = fields[n].length < sizeof(copy) ? fields[n].length : sizeof(copy) - 1;
+    memcpy(copy, data.data() + fields[n].start, length);
+    copy[length] = '\0';
+    double exact = strtod(copy, NULL);
+    double ignored = 0.0;
+    double value = convert(data.data() + fields[n].start, fields[n].length, ignored);
+    double error = fabs(value - exact);
+    if (error > result.max_error) result.max_error = error;
+    if (convert != viaScaled && static_cast<float>(value) != static_cast<float>(exact)) result.inexact++;
+  }
+  return result;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: %s input.gcode [repeat]\n", argv[0]);
+    return 2;
+  }
+  int repeat = argc == 3 ? atoi(argv[2]) : 5;
+  if (repeat < 1) repeat = 1;
+  FILE *in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "ERROR: cannot open %s\n", argv[1]);
+    return 1;
+  }
+  std::vector<char> data;
+  char block[65536];
+  size_t bytesRead;
+  while ((bytesRead = fread(block, 1, sizeof(block), in)) > 0) data.insert(data.end(), block, block + bytesRead);
+  fclose(in);
+
+  std::vector<Field> fields;
+  uint32_t lines;
+  collectFields(data, fields, lines);
+  printf("%lu bytes, %u lines, %lu numeric fields\n", static_cast<unsigned long>(data.size()), lines,
+         static_cast<unsigned long>(fields.size()));
+  if (fields.empty()) return 0;
+
+  static const struct {
+    const char *name;
+    Converter convert;
+  } paths[] = {
+      {"String+toFloat", viaString},
+      {"strtof", viaStrtof},
+      {"decimal->float", viaDecimal},
+      {"decimal->um", viaScaled},
+  };
+  double reference = 0.0;
+  for (size_t n = 0; n < sizeof(paths) / sizeof(paths[0]); n++) {
+    Result result = run(data, fields, paths[n].convert, repeat);
+    if (n == 0) reference = result.best;
+    printf("%-15s %7.1f Mfields/s  %6.1f ns/field  x%.2f  max error %.3g, %u not correctly rounded\n",
+           paths[n].name, fields.size() / result.best / 1e6, result.best * 1e9 / fields.size(), reference / result.best,
+           result.max_error, result.inexact);
+  }
+  return 0;
+}
@@ -0,0 +1,35 @@
+G1 X1e5 Y-.5 Z+3. E-
+G1 X99999999999999999999 Y0.000000000000000001
+G1 X1.2.3 Y--4
+G2 X10 Y0 R0
+G2 X10 Y0 I0 J0
+G3 X0 Y0 R1 I1
+G1 X[1/0]
+#1 = SQRT[-1]
+#255 = 1
+#256 = 1
+#1 = [[[[[[[[[1]]]]]]]]]
+#1 = 1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1
+IF [1] IF [1] G1 X1
+IF [#1 G1 X1
+M98 P999
+O1
+O1
+M99
+M99
+G1 X1 Y2 Z3 E4 F5 X6
+G1 A1 B2
+G999
+M0
+N12 G1 X1*
+N G1
+(((
+;
+   
+G1 F0 X10
+G1 F-100 X20
+G4 P100
+T0
+G99999999999 X1
+M2147483648000
+N99999999999999999999 G1 X1*0
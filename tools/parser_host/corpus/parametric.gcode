@@ -0,0 +1,18 @@
+; Variables, expressions, conditions et sous-programmes
+#1 = 0.2
+#2 = [#1 * 2 + 0.1]
+#3 = #2 * 3
+#4 = SQRT[16] + ABS[-2] + ROUND[1.6] + FIX[2.9]
+#5 = SIN[30] + COS[60]
+#6 = [7 MOD 3]
+#7 = [#1 GT 0.1 AND #2 LT 1 OR #3 EQ 0]
+IF [#7 NE 0] G1 X[#4 * 10] Y-#2 F1200
+IF [#7 EQ 0] G1 X0
+O100
+G1 X[#1 * 100] Y10 E0.5
+G1 X10 Y[#1 * 100] E0.5
+G2 X20 Y10 I5 J0 E0.2
+M99
+M98 P100 L3 Z0.2
+#1 = #1 + 0.1
+M98 P100 L2
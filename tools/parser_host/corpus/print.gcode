@@ -0,0 +1,46 @@
+; Extrait de G-code de slicer : chauffe, origine, couches, arcs, rétractions
+M140 S60
+M104 S210
+M190 S60
+M109 S210
+G21
+G90
+M83
+G28
+G92 E0
+G1 Z0.3 F600
+G1 X10 Y10 F3000
+G1 X60 Y10 E2.5 F1200
+G1 X60 Y60 E2.5
+G1 X10 Y60 E2.5
+G1 X10 Y10.4 E2.48
+G1 E-0.8 F2400
+G0 X35 Y35 F6000
+G1 E0.8 F2400
+;LAYER:1
+G1 Z0.5 F600
+G2 X45 Y35 I5 J0 E1.57 F1800
+G3 X35 Y35 I-5 J0 E1.57
+G2 X35 Y35 I5 J0 E3.14
+G3 X40 Y40 R5 E0.79
+G2 X30 Y40 R-5 E2.36
+M106 S128
+G1 X20.05 Y20.01 E0.05
+G1 X20.10 Y20.02 E0.05
+G1 X20.15 Y20.03 E0.05
+G1 X20.20 Y20.04 E0.05
+G1 X20.25 Y20.05 E0.05
+G1 X30 Y30 E0.5 ; commentaire de fin de ligne
+G91
+G1 Z2 F600
+G90
+G20
+G1 X1 Y1 F100
+G21
+M82
+G1 X50 Y50 E10 F1500
+M83
+M107
+M104 S0
+M140 S0
+G28 X Y
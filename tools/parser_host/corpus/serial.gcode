@@ -0,0 +1,10 @@
+N0 M110 N0*125
+N1 G28*18
+N2 G1 X10 Y10 F3000*78
+N3 g1x20y20e1.5f1200*32
+N4 G1X30Y30(commentaire)E1*52
+N5 M104 S200*98
+N7 G1 X1*99
+N8 #1=#2*3*0
+#1 = #2 * 3
+G1 X5 Y5*12
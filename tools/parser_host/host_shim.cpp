@@ -0,0 +1,159 @@
+// Implémentation hôte des fonctions Arduino, FreeRTOS et ESP-IDF déclarées dans shim/,
+// et globales du firmware définies hors de lib/gcode_parser (system_manager.cpp).
+
+#include <Arduino.h>
+#include <chrono>
+#include <new>
+#include <vector>
+#include "host_shim.h"
+#include "motion_queue.h"
+
+HardwareSerial Serial;
+bool hostSerialEcho = false;
+
+QueueHandle_t gcodeQueue = NULL;
+QueueHandle_t sdQueue = NULL;
+SemaphoreHandle_t errorSemaphore = NULL;
+
+static uint64_t allocations = 0;
+
+uint64_t hostAllocations() {
+  return allocations;
+}
+
+uint32_t hostDrainMotion() {
+  MotionQueueItem item;
+  uint32_t count = 0;
+  while (motionQueue.receive(item, 0)) count++;
+  return count;
+}
+
+static std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count());
+}
+
+unsigned long micros() {
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+  (void)caps;
+  allocations++;
+  return malloc(size);
+}
+
+void *heap_caps_realloc(void *pointer, size_t size, uint32_t caps) {
+  (void)caps;
+  allocations++;
+  return realloc(pointer, size);
+}
+
+void heap_caps_free(void *pointer) {
+  free(pointer);
+}
+
+void *operator new(size_t size) {
+  allocations++;
+  void *pointer = malloc(size ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+void operator delete(void *pointer) noexcept {
+  free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+  free(pointer);
+}
+
+// Queue et sémaphore : tampon circulaire d'éléments de taille fixe ; un sémaphore est
+// une queue d'un octet par jeton dont le nombre de messages est le compteur
+struct HostQueue {
+  std::vector<uint8_t> storage;
+  size_t item_size, length, head, count;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  HostQueue *queue = new HostQueue;
+  queue->storage.resize(static_cast<size_t>(length) * item_size);
+  queue->item_size = item_size;
+  queue->length = length;
+  queue->head = queue->count = 0;
+  return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+  (void)ticks_to_wait;
+  if (!queue || queue->count == queue->length) return pdFALSE;
+  size_t slot = (queue->head + queue->count) % queue->length;
+  memcpy(&queue->storage[slot * queue->item_size], item, queue->item_size);
+  queue->count++;
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait) {
+  (void)ticks_to_wait;
+  if (!queue || queue->count == 0) return pdFALSE;
+  memcpy(item, &queue->storage[queue->head * queue->item_size], queue->item_size);
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  if (queue) queue->head = queue->count = 0;
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return queue ? static_cast<UBaseType_t>(queue->count) : 0;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  SemaphoreHandle_t mutex = xQueueCreate(1, 1);
+  xSemaphoreGive(mutex);
+  return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return xQueueCreate(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+  uint8_t token;
+  return xQueueReceive(semaphore, &token, ticks_to_wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  const uint8_t token = 0;
+  return xQueueSend(semaphore, &token, 0);
+}
+
+static uint32_t notifications = 0;
+static int currentTask;
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return &currentTask;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  (void)task;
+  notifications++;
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+  (void)ticks_to_wait;
+  uint32_t value = notifications;
+  if (value) notifications = clear_on_exit ? 0 : value - 1;
+  return value;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  (void)ticks;
+}
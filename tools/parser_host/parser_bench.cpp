@@ -0,0 +1,123 @@
+// Débit de lib/gcode_parser sur l'hôte, sur un corpus G-code : lignes par seconde et
+// allocations par ligne (heap_caps_* et operator new, String compris) pour chaque étage.
+//
+//   tokenize   tokenizeWords seul
+//   dry run    parseLine sans émission (indexation, saut de lignes)
+//   emit       parseLine + emitCommand, motionQueue vidée après chaque ligne
+//   serial     emit précédé de la copie en String que faisait l'ancien chemin série
+//
+// Construction : voir CMakeLists.txt. Utilisation : parser_bench fichier.gcode [répétitions]
+
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+#include "gcode_parser.h"
+#include "gcode_tokenizer.h"
+#include "host_shim.h"
+#include "motion_queue.h"
+
+struct Line {
+  uint32_t start, length;
+};
+
+// Découpage de la lecture SD : lignes sans '\n', coupées à SD_READ_BUFFER_BYTES
+static void splitLines(const std::vector<char> &data, std::vector<Line> &lines) {
+  size_t pos = 0, size = data.size();
+  while (pos < size) {
+    const char *start = data.data() + pos;
+    const char *newline = static_cast<const char *>(memchr(start, '\n', size - pos));
+    size_t len = newline ? newline - start : size - pos;
+    size_t used = newline ? len + 1 : len;
+    if (len > SD_READ_BUFFER_BYTES) len = used = SD_READ_BUFFER_BYTES;
+    Line line = {static_cast<uint32_t>(pos), static_cast<uint32_t>(len)};
+    lines.push_back(line);
+    pos += used;
+  }
+}
+
+enum class Stage { TOKENIZE, DRY_RUN, EMIT, SERIAL };
+
+static uint32_t runStage(Stage stage, const std::vector<char> &data, const std::vector<Line> &lines) {
+  uint32_t produced = 0;
+  gcodeParser.resetModalState();
+  gcodeParser.resetProgram();
+  gcodeParser.setDryRun(stage == Stage::DRY_RUN);
+  for (size_t n = 0; n < lines.size(); n++) {
+    const char *text = data.data() + lines[n].start;
+    size_t len = lines[n].length;
+    if (stage == Stage::TOKENIZE) {
+      TokenizedLine words;
+      size_t column;
+      if (tokenizeWords(text, len, words, column) == TokenStatus::OK) produced++;
+      continue;
+    }
+    MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+    ParseStatus status;
+    if (stage == Stage::SERIAL) {
+      String copy(std::string(text, len));
+      copy.trim();
+      status = gcodeParser.parseLine(copy.c_str(), copy.length(), cmd);
+    } else {
+      status = gcodeParser.parseLine(text, len, cmd);
+    }
+    if (status != ParseStatus::OK) continue;
+    gcodeParser.emitCommand(cmd); // En dry run : fin d'arc directe, sans segments
+    produced += stage == Stage::DRY_RUN ? 1 : hostDrainMotion();
+  }
+  if (stage == Stage::EMIT || stage == Stage::SERIAL) {
+    gcodeParser.flushMotion();
+    produced += hostDrainMotion();
+  }
+  return produced;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: %s input.gcode [repeat]\n", argv[0]);
+    return 2;
+  }
+  int repeat = argc == 3 ? atoi(argv[2]) : 5;
+  if (repeat < 1) repeat = 1;
+  FILE *in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "ERROR: cannot open %s\n", argv[1]);
+    return 1;
+  }
+  std::vector<char> data;
+  char block[65536];
+  size_t bytesRead;
+  while ((bytesRead = fread(block, 1, sizeof(block), in)) > 0) data.insert(data.end(), block, block + bytesRead);
+  fclose(in);
+
+  std::vector<Line> lines;
+  splitLines(data, lines);
+  printf("%lu bytes, %lu lines\n", static_cast<unsigned long>(data.size()), static_cast<unsigned long>(lines.size()));
+  if (lines.empty()) return 0;
+  gcodeParser.init();
+  motionQueue.init();
+
+  static const struct {
+    const char *name;
+    Stage stage;
+  } stages[] = {
+      {"tokenize", Stage::TOKENIZE},
+      {"dry run", Stage::DRY_RUN},
+      {"emit", Stage::EMIT},
+      {"serial", Stage::SERIAL},
+  };
+  for (size_t s = 0; s < sizeof(stages) / sizeof(stages[0]); s++) {
+    double best = 0.0;
+    uint32_t produced = 0;
+    uint64_t allocated = hostAllocations();
+    for (int r = 0; r < repeat; r++) {
+      std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+      produced = runStage(stages[s].stage, data, lines);
+      double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+      if (r == 0 || elapsed < best) best = elapsed;
+    }
+    double per_line = static_cast<double>(hostAllocations() - allocated) / (static_cast<double>(lines.size()) * repeat);
+    printf("%-9s %8.2f Mlines/s  %7.1f ns/line  %6.3f allocs/line  %lu outputs\n", stages[s].name,
+           lines.size() / best / 1e6, best * 1e9 / lines.size(), per_line, static_cast<unsigned long>(produced));
+  }
+  return 0;
+}
@@ -0,0 +1,150 @@
+// Cible de fuzzing de lib/gcode_parser sur l'hôte : chaque entrée est découpée en lignes
+// comme un fichier SD, puis chaque ligne passe par le contrôle N/somme, le découpage en
+// mots, le parser complet (dispatch, état modal, arcs, sous-programmes, envoi à
+// motionQueue) et le compilateur d'expressions suivi de la machine à pile.
+//
+// Avec libFuzzer (clang, -DPARSER_HOST_LIBFUZZER=ON) : parser_fuzz corpus/
+// Sans libFuzzer, le même binaire rejoue les fichiers ou dossiers donnés en argument,
+// sous ASan/UBSan par défaut : parser_fuzz corpus/ [fichier...]
+
+#include <Arduino.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "gcode_expression.h"
+#include "gcode_parser.h"
+#include "gcode_tokenizer.h"
+#include "host_shim.h"
+#include "motion_queue.h"
+
+static float variables[GCODE_VARIABLE_COUNT];
+
+static void setUp() {
+  static bool ready = false;
+  if (ready) return;
+  ready = true;
+  gcodeParser.init();
+  motionQueue.init();
+  for (int n = 0; n < GCODE_VARIABLE_COUNT; n++) variables[n] = 0.5f * n - 16.0f;
+}
+
+// Expression libre : la ligne entière comme membre droit d'une affectation
+static void fuzzExpression(const char *line, size_t len) {
+  const char *p = line;
+  uint8_t code[GCODE_LINE_BYTECODE];
+  uint8_t size = 0;
+  if (!compileGcodeExpression(p, line + len, code, size, sizeof(code), true)) return;
+  if (p < line || p > line + len || gcodeExpressionLength(code, size) != size) abort(); // Bytecode mal terminé
+  float result;
+  evaluateGcodeExpression(code, variables, result);
+}
+
+static void fuzzLine(const char *line, size_t len) {
+  NumberedLine numbered;
+  checkNumberedLine(line, len, numbered);
+
+  TokenizedLine words;
+  size_t column;
+  if (tokenizeWords(line, len, words, column) == TokenStatus::OK) {
+    MotionCommand cmd;
+    wordsToCommand(words, cmd, variables);
+  }
+
+  MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+  gcodeParser.lock();
+  if (gcodeParser.parseLine(line, len, cmd) == ParseStatus::OK) gcodeParser.emitCommand(cmd);
+  gcodeParser.unlock();
+  hostDrainMotion();
+
+  fuzzExpression(line, len);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  setUp();
+  gcodeParser.lock();
+  gcodeParser.resetModalState();
+  gcodeParser.resetProgram();
+  gcodeParser.setDryRun(false);
+  gcodeParser.unlock();
+
+  const char *text = reinterpret_cast<const char *>(data);
+  size_t pos = 0;
+  bool first = true;
+  while (pos < size) {
+    const char *start = text + pos;
+    const char *newline = static_cast<const char *>(memchr(start, '\n', size - pos));
+    size_t len = newline ? newline - start : size - pos;
+    size_t used = newline ? len + 1 : len;
+    if (len > SD_READ_BUFFER_BYTES) len = used = SD_READ_BUFFER_BYTES; // Coupée comme à la lecture SD
+    if (first) {
+      // TEST_PARSE : même ligne par le chemin String, sur l'analyseur d'essai
+      gcodeParser.testParse(String(std::string(start, len)));
+      first = false;
+    }
+    fuzzLine(start, len);
+    pos += used;
+  }
+  gcodeParser.lock();
+  gcodeParser.flushMotion();
+  gcodeParser.unlock();
+  hostDrainMotion();
+  return 0;
+}
+
+#ifndef PARSER_HOST_LIBFUZZER
+static bool runFile(const std::string &path, size_t &bytes) {
+  FILE *in = fopen(path.c_str(), "rb");
+  if (!in) {
+    fprintf(stderr, "ERROR: cannot open %s\n", path.c_str());
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t block[65536];
+  size_t bytesRead;
+  while ((bytesRead = fread(block, 1, sizeof(block), in)) > 0) data.insert(data.end(), block, block + bytesRead);
+  fclose(in);
+  LLVMFuzzerTestOneInput(data.data(), data.size());
+  bytes += data.size();
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s corpus_dir|file...\n", argv[0]);
+    return 2;
+  }
+  uint32_t inputs = 0;
+  size_t bytes = 0;
+  for (int arg = 1; arg < argc; arg++) {
+    struct stat info;
+    if (stat(argv[arg], &info) != 0) {
+      fprintf(stderr, "ERROR: cannot open %s\n", argv[arg]);
+      return 1;
+    }
+    if (!S_ISDIR(info.st_mode)) {
+      if (!runFile(argv[arg], bytes)) return 1;
+      inputs++;
+      continue;
+    }
+    DIR *dir = opendir(argv[arg]);
+    if (!dir) {
+      fprintf(stderr, "ERROR: cannot open %s\n", argv[arg]);
+      return 1;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+      std::string path = std::string(argv[arg]) + "/" + entry->d_name;
+      if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+      if (!runFile(path, bytes)) {
+        closedir(dir);
+        return 1;
+      }
+      inputs++;
+    }
+    closedir(dir);
+  }
+  printf("%u inputs, %lu bytes replayed\n", inputs, static_cast<unsigned long>(bytes));
+  return 0;
+}
+#endif
@@ -0,0 +1,114 @@
+#pragma once
+
+// Sous-ensemble d'Arduino pour compiler lib/gcode_parser sur l'hôte : String sur
+// std::string et Serial sans port (sortie jetée, ou recopiée sur stdout si
+// hostSerialEcho est vrai).
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <esp_heap_caps.h>
+
+class String {
+private:
+  std::string text;
+
+public:
+  String(const char *value = "") : text(value ? value : "") {}
+  String(const std::string &value) : text(value) {}
+  explicit String(int value) : text(std::to_string(value)) {}
+
+  const char *c_str() const { return text.c_str(); }
+  unsigned int length() const { return static_cast<unsigned int>(text.size()); }
+  bool isEmpty() const { return text.empty(); }
+  char charAt(unsigned int index) const { return index < text.size() ? text[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  void trim() {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) {
+      text.clear();
+      return;
+    }
+    text = text.substr(start, text.find_last_not_of(" \t\r\n") - start + 1);
+  }
+  void toUpperCase() {
+    for (size_t n = 0; n < text.size(); n++) {
+      if (text[n] >= 'a' && text[n] <= 'z') text[n] = static_cast<char>(text[n] - 'a' + 'A');
+    }
+  }
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t found = text.find(c, from);
+    return found == std::string::npos ? -1 : static_cast<int>(found);
+  }
+  int indexOf(const char *value, unsigned int from = 0) const {
+    size_t found = text.find(value, from);
+    return found == std::string::npos ? -1 : static_cast<int>(found);
+  }
+  String substring(unsigned int from, unsigned int to = 0xFFFFFFFFu) const {
+    if (from > text.size()) return String();
+    if (to > text.size()) to = static_cast<unsigned int>(text.size());
+    return to > from ? String(text.substr(from, to - from)) : String();
+  }
+  bool startsWith(const char *prefix) const { return text.compare(0, strlen(prefix), prefix) == 0; }
+  bool endsWith(const char *suffix) const {
+    size_t len = strlen(suffix);
+    return text.size() >= len && text.compare(text.size() - len, len, suffix) == 0;
+  }
+  long toInt() const { return strtol(text.c_str(), NULL, 10); }
+  float toFloat() const { return static_cast<float>(atof(text.c_str())); }
+
+  String &operator+=(const String &other) {
+    text += other.text;
+    return *this;
+  }
+  String &operator+=(const char *other) {
+    text += other;
+    return *this;
+  }
+  String &operator+=(char c) {
+    text += c;
+    return *this;
+  }
+  String operator+(const String &other) const { return String(text + other.text); }
+  String operator+(const char *other) const { return String(text + other); }
+  bool operator==(const String &other) const { return text == other.text; }
+  bool operator==(const char *other) const { return text == other; }
+  bool operator!=(const String &other) const { return text != other.text; }
+};
+
+extern bool hostSerialEcho;
+
+class HardwareSerial {
+public:
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    if (!hostSerialEcho) return 0;
+    va_list args;
+    va_start(args, format);
+    int written = vprintf(format, args);
+    va_end(args);
+    return written > 0 ? written : 0;
+  }
+  size_t print(const char *text) {
+    if (!hostSerialEcho) return 0;
+    fputs(text, stdout);
+    return strlen(text);
+  }
+  size_t print(const String &text) { return print(text.c_str()); }
+  size_t println(const char *text = "") { return print(text) + print("\n"); }
+  size_t println(const String &text) { return println(text.c_str()); }
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "queue.h"
+
+// Sémaphores et mutex : compteurs sans attente, un seul fil les utilise
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Une seule tâche : les notifications s'accumulent et ulTaskNotifyTake les relève
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+void vTaskDelay(TickType_t ticks);
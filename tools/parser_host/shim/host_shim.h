@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+// Allocations depuis le démarrage : heap_caps_* et operator new (String compris)
+uint64_t hostAllocations();
+
+// Vide motionQueue comme le ferait son consommateur ; retourne le nombre de mouvements
+uint32_t hostDrainMotion();
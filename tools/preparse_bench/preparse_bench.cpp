@@ -0,0 +1,163 @@
+// Mesure sur l'hôte le gain du pré-découpage parallèle (SD_PARALLEL_PARSE) : le même
+// fichier est traité sur un seul fil, puis par deux fils reproduisant PreparseTask
+// (cœur 0 : découpage et tokenisation) et sdTask (cœur 1 : passe séquentielle).
+//
+// Construction sur l'hôte, depuis la racine du dépôt :
+//   g++ -O2 -std=c++11 -pthread -Ilib/gcode_parser -o preparse_bench
+//       tools/preparse_bench/preparse_bench.cpp lib/gcode_parser/gcode_preparse.cpp
+//       lib/gcode_parser/gcode_tokenizer.cpp lib/gcode_parser/gcode_number.cpp
+//       lib/gcode_parser/gcode_expression.cpp lib/gcode_parser/motion_merger.cpp
+//
+// Utilisation : preparse_bench fichier.gcode [répétitions]
+//
+// La passe séquentielle simulée se limite à wordsToCommand et à l'étage de fusion :
+// l'état modal et l'envoi à motionQueue du firmware l'alourdissent, ce qui rapproche
+// le gain réel de 2x sur les fichiers denses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "gcode_preparse.h"
+#include "motion_merger.h"
+
+// Passe séquentielle : conversion et fusion, dans l'ordre des lignes
+struct Consumer {
+  MotionMerger merger;
+  float variables[GCODE_VARIABLE_COUNT];
+  uint32_t lines, errors, commands;
+  double checksum; // Dépend de l'ordre de traitement : identique dans les deux modes
+
+  Consumer() : lines(0), errors(0), commands(0), checksum(0.0) { memset(variables, 0, sizeof(variables)); }
+
+  void consume(const PreparsedLine &line) {
+    lines++;
+    MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+    if (line.status != TokenStatus::OK || wordsToCommand(line.words, cmd, variables) != TokenStatus::OK) {
+      errors++;
+      return;
+    }
+    MotionCommand ready[2];
+    uint8_t count = merger.push(cmd, ready);
+    for (uint8_t n = 0; n < count; n++) emit(ready[n]);
+  }
+
+  void finish() {
+    MotionCommand cmd;
+    if (merger.flush(cmd)) emit(cmd);
+  }
+
+  void emit(const MotionCommand &cmd) {
+    commands++;
+    checksum = checksum * 0.5 + cmd.x + 2.0 * cmd.y + 3.0 * cmd.e + commands;
+  }
+};
+
+// Découpage sur le fichier en mémoire, comme PreparseTask sur la fenêtre de lecture
+// anticipée (sd_read_ahead.h) : les lignes ne sont jamais recopiées
+class Reader {
+private:
+  const std::vector<char> &data;
+  size_t position;
+  uint32_t line_number, offset;
+
+public:
+  explicit Reader(const std::vector<char> &source) : data(source), position(0), line_number(0), offset(0) {}
+
+  // Remplit chunk ; retourne false après le dernier bloc
+  bool fill(PreparsedChunk &chunk) {
+    position += preparseLines(data.data() + position, data.size() - position, true, line_number, offset, chunk);
+    chunk.last = position == data.size();
+    return !chunk.last;
+  }
+};
+
+static double runSingle(const std::vector<char> &data, Consumer &consumer) {
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  Reader reader(data);
+  PreparsedChunk *chunk = new PreparsedChunk;
+  bool more = true;
+  while (more) {
+    chunk->count = 0;
+    more = reader.fill(*chunk);
+    for (uint16_t n = 0; n < chunk->count; n++) consumer.consume(chunk->lines[n]);
+  }
+  consumer.finish();
+  delete chunk;
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+static double runParallel(const std::vector<char> &data, Consumer &consumer) {
+  std::vector<PreparsedChunk> storage(PREPARSE_SLOTS);
+  PreparseBuffer preparse;
+  preparse.attach(storage.data(), PREPARSE_SLOTS);
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+  std::thread producer([&]() {
+    Reader reader(data);
+    bool more = true;
+    for (uint32_t sequence = 0; more; sequence++) {
+      PreparsedChunk *chunk;
+      while (!(chunk = preparse.acquire(sequence))) std::this_thread::yield();
+      more = reader.fill(*chunk);
+      preparse.publish(chunk);
+    }
+  });
+
+  bool last = false;
+  for (uint32_t sequence = 0; !last; sequence++) {
+    PreparsedChunk *chunk;
+    while (!(chunk = preparse.peek(sequence))) std::this_thread::yield();
+    for (uint16_t n = 0; n < chunk->count; n++) consumer.consume(chunk->lines[n]);
+    last = chunk->last;
+    preparse.release(sequence);
+  }
+  consumer.finish();
+  producer.join();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: %s input.gcode [repeat]\n", argv[0]);
+    return 2;
+  }
+  int repeat = argc == 3 ? atoi(argv[2]) : 5;
+  if (repeat < 1) repeat = 1;
+  FILE *in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "ERROR: cannot open %s\n", argv[1]);
+    return 1;
+  }
+  std::vector<char> data;
+  char block[65536];
+  size_t bytesRead;
+  while ((bytesRead = fread(block, 1, sizeof(block), in)) > 0) data.insert(data.end(), block, block + bytesRead);
+  fclose(in);
+
+  // Meilleur temps de chaque mode sur les répétitions
+  double single = 0.0, parallel = 0.0;
+  Consumer reference, check;
+  for (int n = 0; n < repeat; n++) {
+    Consumer first, second;
+    double t1 = runSingle(data, first);
+    double t2 = runParallel(data, second);
+    if (n == 0 || t1 < single) single = t1;
+    if (n == 0 || t2 < parallel) parallel = t2;
+    reference = first;
+    check = second;
+  }
+  if (reference.lines != check.lines || reference.commands != check.commands || reference.checksum != check.checksum) {
+    fprintf(stderr, "ERROR: parallel result differs (%u/%u lines, %u/%u commands)\n", reference.lines, check.lines,
+            reference.commands, check.commands);
+    return 1;
+  }
+  printf("%lu bytes, %u lines, %u commands, %u errors\n", static_cast<unsigned long>(data.size()), reference.lines,
+         reference.commands, reference.errors);
+  printf("single:   %.0f lines/s, %.1f MB/s\n", reference.lines / single, data.size() / single / 1e6);
+  printf("parallel: %.0f lines/s, %.1f MB/s (x%.2f)\n", reference.lines / parallel, data.size() / parallel / 1e6,
+         single / parallel);
+  return 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Configuration minimale du portage POSIX pour spsc_bench
+#define configUSE_PREEMPTION 1
+#define configUSE_TIME_SLICING 1
+#define configUSE_IDLE_HOOK 0
+#define configUSE_TICK_HOOK 0
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 5
+#define configMINIMAL_STACK_SIZE ((unsigned short)4096)
+#define configMAX_TASK_NAME_LEN 16
+#define configUSE_16_BIT_TICKS 0
+#define configUSE_MUTEXES 1
+#define configUSE_TASK_NOTIFICATIONS 1
+#define configSUPPORT_DYNAMIC_ALLOCATION 1
+#define configSUPPORT_STATIC_ALLOCATION 0
+#define configTOTAL_HEAP_SIZE ((size_t)(1024 * 1024))
+#define configCHECK_FOR_STACK_OVERFLOW 0
+#define configUSE_TRACE_FACILITY 0
+#define configGENERATE_RUN_TIME_STATS 0
+
+#define INCLUDE_vTaskDelete 1
+#define INCLUDE_vTaskDelay 1
+#define INCLUDE_xTaskGetCurrentTaskHandle 1
+
+#define configASSERT(x) \
+  if (!(x)) vAssertCalled(__FILE__, __LINE__)
+#ifdef __cplusplus
+extern "C"
+#endif
+void vAssertCalled(const char *file, unsigned long line);
@@ -0,0 +1,121 @@
+// Compare sur l'hôte le coût par élément de SpscRing (lib/spsc_ring) et des queues du
+// noyau (xQueueSend / xQueueReceive), entre deux tâches FreeRTOS du portage POSIX.
+// Le portage POSIX n'exécute qu'une tâche à la fois (comme un seul cœur) : la mesure
+// porte sur le coût des appels et des réveils, pas sur le parallélisme des deux cœurs.
+//
+// Construction sur l'hôte, depuis la racine du dépôt, avec FreeRTOS-Kernel dans $K :
+//   P=$K/portable/ThirdParty/GCC/Posix
+//   mkdir -p spsc_inc && ln -sfn $K/include spsc_inc/freertos
+//   gcc -O2 -c -Itools/spsc_bench -I$K/include -I$P -I$P/utils $K/tasks.c $K/queue.c
+//       $K/list.c $P/port.c $P/utils/wait_for_event.c $K/portable/MemMang/heap_3.c
+//   g++ -O2 -std=gnu++11 -pthread -Itools/spsc_bench -Ispsc_inc -I$K/include -I$P
+//       -Ilib/spsc_ring -o spsc_bench tools/spsc_bench/spsc_bench.cpp *.o
+//
+// Utilisation : spsc_bench [éléments]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "spsc_ring.h"
+
+// Taille d'un G1 XYZEF une fois compacté pour motionQueue
+struct BenchItem {
+  uint32_t sequence;
+  float values[6];
+};
+
+#define BENCH_QUEUE_LENGTH 64
+#define BENCH_BATCH 16
+#define BENCH_STACK (configMINIMAL_STACK_SIZE * 4)
+
+enum BenchMode { KERNEL_QUEUE, RING_SINGLE, RING_BATCH };
+static const char *const modeNames[] = {"xQueueSend/xQueueReceive", "SpscRing push/pop", "SpscRing batch"};
+
+static SpscRing<BenchItem, BENCH_QUEUE_LENGTH> ring;
+static QueueHandle_t queue;
+static BenchMode mode;
+static uint32_t itemCount;
+static uint32_t errors;
+static TaskHandle_t benchTaskHandle;
+
+static void producerTask(void *pvParameters) {
+  BenchItem batch[BENCH_BATCH];
+  for (uint32_t n = 0; n < itemCount;) {
+    size_t count = mode == RING_BATCH ? BENCH_BATCH : 1;
+    if (count > itemCount - n) count = itemCount - n;
+    for (size_t i = 0; i < count; i++) {
+      batch[i].sequence = n + i;
+      for (uint8_t v = 0; v < 6; v++) batch[i].values[v] = static_cast<float>(n + i + v);
+    }
+    if (mode == KERNEL_QUEUE) {
+      xQueueSend(queue, &batch[0], portMAX_DELAY);
+      n++;
+    } else {
+      size_t sent = 0;
+      while (sent < count) {
+        ring.waitForSpace(1, portMAX_DELAY);
+        sent += ring.pushBatch(batch + sent, count - sent);
+      }
+      n += count;
+    }
+  }
+  vTaskDelete(NULL);
+}
+
+static void consumerTask(void *pvParameters) {
+  BenchItem batch[BENCH_BATCH];
+  for (uint32_t n = 0; n < itemCount;) {
+    size_t count = 1;
+    if (mode == KERNEL_QUEUE) {
+      xQueueReceive(queue, &batch[0], portMAX_DELAY);
+    } else {
+      ring.waitForData(1, portMAX_DELAY);
+      count = ring.popBatch(batch, mode == RING_BATCH ? BENCH_BATCH : 1);
+    }
+    for (size_t i = 0; i < count; i++, n++) {
+      if (batch[i].sequence != n || batch[i].values[5] != static_cast<float>(n + 5)) errors++;
+    }
+  }
+  xTaskNotifyGive(benchTaskHandle);
+  vTaskDelete(NULL);
+}
+
+static void benchTask(void *pvParameters) {
+  double reference = 0.0;
+  for (int m = KERNEL_QUEUE; m <= RING_BATCH; m++) {
+    mode = static_cast<BenchMode>(m);
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    xTaskCreate(consumerTask, "consumer", BENCH_STACK, NULL, tskIDLE_PRIORITY + 1, NULL);
+    xTaskCreate(producerTask, "producer", BENCH_STACK, NULL, tskIDLE_PRIORITY + 1, NULL);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (m == KERNEL_QUEUE) reference = seconds;
+    printf("%-26s %10.0f items/s  %7.1f ns/item  (x%.2f)\n", modeNames[m], itemCount / seconds,
+           seconds * 1e9 / itemCount, reference / seconds);
+  }
+  if (errors) fprintf(stderr, "ERROR: %u items out of order\n", errors);
+  exit(errors ? 1 : 0);
+}
+
+extern "C" void vAssertCalled(const char *file, unsigned long line) {
+  fprintf(stderr, "ERROR: FreeRTOS assertion %s:%lu\n", file, line);
+  abort();
+}
+
+int main(int argc, char **argv) {
+  itemCount = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  if (!itemCount) itemCount = 1;
+  queue = xQueueCreate(BENCH_QUEUE_LENGTH, sizeof(BenchItem));
+  // Priorité supérieure aux deux tâches mesurées : ne reprend la main qu'à la fin d'un mode
+  if (!queue || !ring.init() || xTaskCreate(benchTask, "bench", BENCH_STACK, NULL, tskIDLE_PRIORITY + 2, &benchTaskHandle) != pdPASS) {
+    fprintf(stderr, "ERROR: cannot create bench task\n");
+    return 1;
+  }
+  printf("%u items of %u bytes, queue length %u, batch %u\n", itemCount, (unsigned)sizeof(BenchItem),
+         (unsigned)BENCH_QUEUE_LENGTH, (unsigned)BENCH_BATCH);
+  vTaskStartScheduler();
+  return 1;
+}